@@ -0,0 +1,235 @@
+//implement the time indexed balances
+#include <algorithm>
+
+#include "BalanceIndex.h"
+#include "NameTable.h"
+
+namespace {
+    constexpr int initial_days = 64;
+
+    //a Fenwick tree over day buckets
+    class FenwickTree {
+    public:
+        explicit FenwickTree(int size): tree(size + 1, 0.0) {}
+
+        int size() const noexcept {
+            return tree.size() - 1;
+        }
+
+        void add(int pos, double value) {
+            for (++pos; pos < static_cast<int>(tree.size()); pos += pos & -pos) {
+                tree[pos] += value;
+            }
+        }
+
+        //sum of the buckets [0, pos]
+        double prefix(int pos) const {
+            double sum = 0.0;
+            for (++pos; pos > 0; pos -= pos & -pos) {
+                sum += tree[pos];
+            }
+            return sum;
+        }
+
+        //shift every bucket right by offset and grow to new_size, O(n)
+        void rebase(int offset, int new_size) {
+            //undo the build to get the raw bucket values back
+            const int n = size();
+            for (int pos = n; pos > 0; --pos) {
+                int parent = pos + (pos & -pos);
+                if (parent <= n)    tree[parent] -= tree[pos];
+            }
+            std::vector<double> rebased(new_size + 1, 0.0);
+            for (int pos = 1; pos <= n; ++pos) {
+                rebased[pos + offset] = tree[pos];
+            }
+            tree.swap(rebased);
+            for (int pos = 1; pos <= new_size; ++pos) {
+                int parent = pos + (pos & -pos);
+                if (parent <= new_size) tree[parent] += tree[pos];
+            }
+        }
+
+    private:
+        //1-based, tree[0] is not used
+        std::vector<double> tree;
+    };
+} //anonymous namespace
+
+namespace AccountBalancer {
+    struct BalanceIndex::BalanceIndexImpl {
+        NameTable names;
+        //one tree per participant ID
+        std::vector<FenwickTree> trees;
+        //net balance of all the days per participant ID, kept along with the trees
+        std::vector<double> totals;
+        //bucket 0 is the day origin, there are capacity buckets in each tree
+        int origin = 0;
+        int capacity = 0;
+
+        //make sure the given day has a bucket, grow (doubling) when it does not
+        void ensureDay(int day) {
+            if (capacity == 0) {
+                origin = day;
+                capacity = initial_days;
+                for (auto& tree: trees) {
+                    tree = FenwickTree(capacity);
+                }
+                return;
+            }
+            if (day >= origin && day < origin + capacity)   return;
+            int first = std::min(origin, day), last = std::max(origin + capacity, day + 1);
+            int new_capacity = std::max(2 * capacity, last - first);
+            //leave some room on the side that grows
+            int new_origin = day < origin? last - new_capacity: origin;
+            for (auto& tree: trees) {
+                tree.rebase(origin - new_origin, new_capacity);
+            }
+            origin = new_origin;
+            capacity = new_capacity;
+        }
+
+        int idOf(const std::string& name) {
+            int id = names.intern(name);
+            if (id == static_cast<int>(trees.size())) {
+                trees.push_back(FenwickTree(capacity));
+                totals.push_back(0.0);
+            }
+            return id;
+        }
+
+        double prefix(int id, int day) const {
+            int pos = day - origin;
+            if (pos < 0)    return 0.0;
+            return trees[id].prefix(std::min(pos, capacity - 1));
+        }
+
+        //the k largest totals after multiplying by sign, only those above zero
+        //a min-heap of size k holds the best so far, O(n log k)
+        std::vector<std::pair<std::string, double>> topTotals(std::size_t k, double sign) const {
+            if (k == 0) return {};
+            using Entry = std::pair<double, int>;
+            //the smallest amount on top, ties broken by name order through the ID
+            auto worse = [this] (const Entry& lhs, const Entry& rhs) {
+                if (lhs.first != rhs.first) return lhs.first > rhs.first;
+                return names.name(lhs.second) < names.name(rhs.second);
+            };
+            std::vector<Entry> heap;
+            heap.reserve(k + 1);
+            for (int id = 0; id < static_cast<int>(totals.size()); ++id) {
+                double amount = sign * totals[id];
+                //less than half a cent is settled
+                if (amount < 0.005) continue;
+                Entry entry(amount, id);
+                if (heap.size() == k) {
+                    if (!worse(entry, heap.front()))    continue;
+                    std::pop_heap(heap.begin(), heap.end(), worse);
+                    heap.back() = entry;
+                }
+                else {
+                    heap.push_back(entry);
+                }
+                std::push_heap(heap.begin(), heap.end(), worse);
+            }
+            std::sort_heap(heap.begin(), heap.end(), worse);
+            std::vector<std::pair<std::string, double>> res;
+            for (auto& entry: heap) {
+                res.push_back(std::make_pair(names.name(entry.second), sign * entry.first));
+            }
+            return res;
+        }
+    };
+
+    BalanceIndex::BalanceIndex(): pimpl(std::make_unique<BalanceIndexImpl>()) {}
+
+    BalanceIndex::~BalanceIndex() = default;
+
+    void BalanceIndex::clear() {
+        pimpl = std::make_unique<BalanceIndexImpl>();
+    }
+
+    void BalanceIndex::applyExpense(const Expense& expense, const ExchangeRates& rates, double sign) {
+        double weight_sum = static_cast<double>(expense.getWeightSum());
+        if (weight_sum == 0.0)  return;
+        if (!rates.hasRate(expense.getCurrency())) {
+            std::cerr << "no exchange rate for currency " << expense.getCurrency() << std::endl;
+            return;
+        }
+        double amount = sign * rates.toBase(expense.getAmount(), expense.getCurrency());
+        pimpl->ensureDay(expense.getDate());
+        int bucket = expense.getDate() - pimpl->origin;
+        int creditor = pimpl->idOf(expense.getCreditor());
+        pimpl->trees[creditor].add(bucket, amount);
+        pimpl->totals[creditor] += amount;
+        for (auto& weight: expense.getWeightsMap()) {
+            int id = pimpl->idOf(weight.first);
+            double share = -amount * weight.second / weight_sum;
+            pimpl->trees[id].add(bucket, share);
+            pimpl->totals[id] += share;
+        }
+    }
+
+    void BalanceIndex::addExpense(const Expense& expense, const ExchangeRates& rates) {
+        applyExpense(expense, rates, 1.0);
+    }
+
+    void BalanceIndex::removeExpense(const Expense& expense, const ExchangeRates& rates) {
+        applyExpense(expense, rates, -1.0);
+    }
+
+    void BalanceIndex::addBalance(const std::string& name, int day, double amount) {
+        pimpl->ensureDay(day);
+        int id = pimpl->idOf(name);
+        pimpl->trees[id].add(day - pimpl->origin, amount);
+        pimpl->totals[id] += amount;
+    }
+
+    double BalanceIndex::balanceAsOf(const std::string& name, int day) const {
+        int id = pimpl->names.find(name);
+        if (id < 0) return 0.0;
+        return pimpl->prefix(id, day);
+    }
+
+    double BalanceIndex::balanceBetween(const std::string& name, int from, int to) const {
+        int id = pimpl->names.find(name);
+        if (id < 0 || from > to) return 0.0;
+        return pimpl->prefix(id, to) - pimpl->prefix(id, from - 1);
+    }
+
+    std::vector<std::pair<std::string, double>> BalanceIndex::balancesAsOf(int day) const {
+        std::vector<std::pair<std::string, double>> res;
+        for (int id = 0; id < pimpl->names.size(); ++id) {
+            res.push_back(std::make_pair(pimpl->names.name(id), pimpl->prefix(id, day)));
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    std::vector<std::pair<std::string, double>> BalanceIndex::balancesBetween(int from, int to) const {
+        std::vector<std::pair<std::string, double>> res;
+        if (from > to)  return res;
+        for (int id = 0; id < pimpl->names.size(); ++id) {
+            res.push_back(std::make_pair(pimpl->names.name(id),
+                        pimpl->prefix(id, to) - pimpl->prefix(id, from - 1)));
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    std::vector<std::pair<std::string, double>> BalanceIndex::currentBalances() const {
+        std::vector<std::pair<std::string, double>> res;
+        for (int id = 0; id < pimpl->names.size(); ++id) {
+            res.push_back(std::make_pair(pimpl->names.name(id), pimpl->totals[id]));
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    std::vector<std::pair<std::string, double>> BalanceIndex::topCreditors(std::size_t k) const {
+        return pimpl->topTotals(k, 1.0);
+    }
+
+    std::vector<std::pair<std::string, double>> BalanceIndex::topDebtors(std::size_t k) const {
+        return pimpl->topTotals(k, -1.0);
+    }
+} //AccountBalancer
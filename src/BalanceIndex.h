@@ -0,0 +1,61 @@
+//Per-participant net balances of a ledger indexed over time
+//every participant keeps a Fenwick tree over day buckets, so the balance as of a date,
+//or the change of balance between two dates, is a O(log n) prefix sum query
+#ifndef __BALANCE_BALANCE_INDEX_H
+#define __BALANCE_BALANCE_INDEX_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Currency.h"
+#include "Expense.h"
+
+namespace AccountBalancer {
+    class BalanceIndex {
+    private:
+        struct BalanceIndexImpl;
+        std::unique_ptr<BalanceIndexImpl> pimpl;
+
+        void applyExpense(const Expense& expense, const ExchangeRates& rates, double sign);
+
+    public:
+        BalanceIndex();
+
+        ~BalanceIndex();
+
+        //forget every balance
+        void clear();
+
+        //keep the index up to date when an expense is committed or undone
+        void addExpense(const Expense& expense, const ExchangeRates& rates = ExchangeRates());
+        void removeExpense(const Expense& expense, const ExchangeRates& rates = ExchangeRates());
+
+        //change a single participant's balance on the given day, e.g. a balance carried
+        //forward from a closed epoch, in the base currency
+        void addBalance(const std::string& name, int day, double amount);
+
+        //[name, balance] of everybody over all the days
+        std::vector<std::pair<std::string, double>> currentBalances() const;
+
+        //net balance (payment made minus share of expenses) up to the given day, inclusive
+        //positive means this person is owed money
+        double balanceAsOf(const std::string& name, int day) const;
+
+        //change of the net balance between two days, both inclusive
+        double balanceBetween(const std::string& name, int from, int to) const;
+
+        //[name, balance] of everybody as of the given day
+        std::vector<std::pair<std::string, double>> balancesAsOf(int day) const;
+
+        //[name, balance change] of everybody between two days
+        std::vector<std::pair<std::string, double>> balancesBetween(int from, int to) const;
+
+        //[name, balance] of the k people owed the most, largest first, without going through
+        //the whole ledger or making any transfer, O(n log k) over the running balances
+        std::vector<std::pair<std::string, double>> topCreditors(std::size_t k) const;
+
+        //[name, balance] of the k people owing the most, most negative first
+        std::vector<std::pair<std::string, double>> topDebtors(std::size_t k) const;
+    };
+} //AccountBalancer
+#endif
@@ -1,13 +1,22 @@
 //Implementation for the control of whole program
 //Created by Theodore Yang on 1/4/2017
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <fstream>
 #include <deque>
-#include <set>
+#include <map>
 #include <unordered_map>
 
 #include "Expense.h"
 #include "Control.h"
 #include "Optimizer.h"
+#include "DebtMatrix.h"
+#include "BalanceIndex.h"
+#include "ParticipantIndex.h"
+#include "ExpenseQueue.h"
+#include "ParticipantPool.h"
+#include "TransferWriter.h"
 
 namespace {
     constexpr const char* welcome 
@@ -35,6 +44,7 @@ namespace {
         SHOW,
         OPT,
         UNDO,
+        SETTLE,
         HELP,
         QUIT
     };
@@ -62,6 +72,7 @@ namespace {
             {"show", CommandMain::SHOW},
             {"opt", CommandMain::OPT},
             {"undo", CommandMain::UNDO},
+            {"settle", CommandMain::SETTLE},
             {"help", CommandMain::HELP},
             {"quit", CommandMain::QUIT},
         };
@@ -76,17 +87,36 @@ namespace {
             {"quit", CommandExpense::QUIT},
             {"help", CommandExpense::HELP}
         };
+
+    bool endsWith(const std::string& str, const std::string& suffix) {
+        return str.size() >= suffix.size()
+            && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
 } //anonymous namespace
 
 namespace AccountBalancer {
     struct Control::ControlImpl {
         std::deque<std::shared_ptr<Expense>> expense_hist;
-        std::set<std::string> participants;
+        //expenses submitted by other threads, not committed yet
+        ExpenseQueue submitted;
+        ParticipantPool participants;
+        //exchange rates of this ledger
+        ExchangeRates rates;
+        //net balances of the committed expenses over time
+        BalanceIndex balances;
+        //balances carried forward from the closed epochs, expense_hist only holds the
+        //expenses of the current epoch
+        std::map<std::string, double> opening_balances;
+        //the day the opening balances were carried forward
+        int opening_day = 0;
+        //participant to committed expenses
+        std::shared_ptr<ParticipantIndex> index = std::make_shared<ParticipantIndex>();
         //optimizer contains all the optimization history
         std::unique_ptr<BalanceOptimizer> optimizer;
         ControlStatus status = Main;
 
-        //last expense commit, use to justify whether an optimization result is valid
+        //last change of the ledger (commit, undo or settle), use to justify whether an
+        //optimization result is valid
         std::chrono::time_point<std::chrono::system_clock> last_expense_commit_time = 
             std::chrono::system_clock::now();
     };
@@ -97,12 +127,16 @@ namespace AccountBalancer {
 
     //undo expense
     void Control::undoExpense() {
+        mergeSubmitted();
         if (pimpl->expense_hist.empty()) {
             std::cerr << "No expense history yet" << std::endl;
         }
         else {
             auto expense_ptr = pimpl->expense_hist.front();
             pimpl->expense_hist.pop_front();
+            pimpl->balances.removeExpense(*expense_ptr, pimpl->rates);
+            pimpl->index->removeExpense(expense_ptr);
+            pimpl->last_expense_commit_time = std::chrono::system_clock::now();
         }
     }
 
@@ -124,7 +158,7 @@ namespace AccountBalancer {
 
     //add and remove all the folks
     void Control::addFolks(const std::vector<std::string>& folks) {
-        pimpl->participants.insert(folks.begin(), folks.end());
+        pimpl->participants.insert(folks);
         std::cout << "added " << pimpl->participants.size() << " folks" << std::endl;
     }
 
@@ -142,38 +176,200 @@ namespace AccountBalancer {
         }
     }
 
-    bool Control::validateParticipant(const std::set<std::string>& names) {
-        for (auto& name: names) {
-            if (pimpl->participants.find(name) == pimpl->participants.end()) {
-                std::cerr << name << " is not in the participants list" << std::endl;
-                return false;
-            }
+    bool Control::validateParticipant(const std::vector<std::string>& names) const {
+        std::size_t missing = pimpl->participants.findMissing(names);
+        if (missing != names.size()) {
+            std::cerr << names[missing] << " is not in the participants list" << std::endl;
+            return false;
         }
         return true;
     }
 
     void Control::printFolks() const {
-        for (auto& name: pimpl->participants) {
+        for (auto& name: pimpl->participants.sortedNames()) {
             std::cout << name << "  ";
         }
         std::cout << std::endl;
     }
 
+    void Control::printParticipantExpenses(const std::vector<std::string>& names) const {
+        for (auto& name: names) {
+            std::cout << std::endl;
+            if (!pimpl->index->printParticipantExpenses(name, pimpl->rates)) {
+                std::cerr << name << " is not in any expense" << std::endl;
+            }
+        }
+    }
+
+    void Control::printDebts(const std::vector<std::string>& names) const {
+        std::vector<std::shared_ptr<Expense>> expenses(pimpl->expense_hist.begin(),
+                pimpl->expense_hist.end());
+        DebtMatrix(expenses, pimpl->rates).printReport(names);
+    }
+
+    void Control::printBalances(const std::vector<std::string>& dates) const {
+        int from = 0, to = Utils::today();
+        if (dates.size() > 2 || (dates.size() >= 1 && !Utils::parseDate(dates.back(), to))
+                || (dates.size() == 2 && !Utils::parseDate(dates.front(), from))) {
+            std::cerr << "dates must be in YYYY-MM-DD format, at most two of them" << std::endl;
+            return;
+        }
+        std::vector<std::pair<std::string, double>> balances;
+        if (dates.size() == 2) {
+            std::cout << "Balance changes from " << Utils::formatDate(from)
+                << " to " << Utils::formatDate(to) << std::endl;
+            balances = pimpl->balances.balancesBetween(from, to);
+        }
+        else {
+            std::cout << "Balances as of " << Utils::formatDate(to) << std::endl;
+            balances = pimpl->balances.balancesAsOf(to);
+        }
+        for (auto& balance: balances) {
+            printf("%-20s $%.2f\n", balance.first.c_str(), balance.second);
+        }
+    }
+
+    void Control::printTopBalances(const std::vector<std::string>& args) const {
+        char* end = nullptr;
+        long k = args.size() == 1? std::strtol(args[0].c_str(), &end, 10): 0;
+        if (k <= 0 || *end != '\0') {
+            std::cerr << "-top requires a positive number" << std::endl;
+            return;
+        }
+        std::cout << "Owed the most" << std::endl;
+        for (auto& balance: pimpl->balances.topCreditors(k)) {
+            printf("%-20s $%.2f\n", balance.first.c_str(), balance.second);
+        }
+        std::cout << "Owing the most" << std::endl;
+        for (auto& balance: pimpl->balances.topDebtors(k)) {
+            printf("%-20s $%.2f\n", balance.first.c_str(), balance.second);
+        }
+    }
+
+    void Control::printTransfers(const std::vector<std::string>& names) const {
+        if (!pimpl->optimizer || !pimpl->optimizer->isUpToTime(pimpl->last_expense_commit_time)) {
+            std::cerr << "the transfers are out of date, run \"opt\" first" << std::endl;
+            return;
+        }
+        if (names.empty()) {
+            for (auto& transfer: pimpl->optimizer->getTransfers()) {
+                printf("%-20s pays %-20s $%.2f\n", transfer.debtor.c_str(),
+                        transfer.creditor.c_str(), transfer.amount);
+            }
+            return;
+        }
+        for (auto& name: names) {
+            std::cout << std::endl;
+            if (pimpl->optimizer->printParticipantTransfers(name) != OptimizerStatus::SUCCESS) {
+                std::cerr << name << " is not in any expense" << std::endl;
+            }
+        }
+    }
+
     //The main menu show option
     void Control::showMain(const std::vector<std::string>& args) {
+        if (args.empty()) {
+            std::cerr << "show requires an option, 'help' for more info" << std::endl;
+            return;
+        }
+        mergeSubmitted();
+        const std::string& option = args[0];
+        const std::vector<std::string> names(args.begin() + 1, args.end());
+        if (option == "-p") {
+            printFolks();
+        }
+        else if (option == "-e") {
+            if (names.empty())  printExpense();
+            else    printParticipantExpenses(names);
+        }
+        else if (option == "-d") {
+            printDebts(names);
+        }
+        else if (option == "-b") {
+            printBalances(names);
+        }
+        else if (option == "-top") {
+            printTopBalances(names);
+        }
+        else if (option == "-t") {
+            printTransfers(names);
+        }
         //TODO
     }
 
+    //The main menu opt option
+    void Control::optimizeMain(const std::vector<std::string>& args) {
+        OptimizerStrategy strategy = OptimizerStrategy::LAZY;
+        std::string output;
+        for (std::size_t pos = 0; pos < args.size(); ++pos) {
+            if (args[pos] == "-l") {
+                strategy = OptimizerStrategy::LAZY;
+            }
+            else if (args[pos] == "-e") {
+                strategy = OptimizerStrategy::LEAST_TRANSFER;
+            }
+            else if (args[pos] == "-s") {
+                strategy = OptimizerStrategy::LOCAL_SEARCH;
+            }
+            else if (args[pos] == "-o" && pos + 1 < args.size()) {
+                output = args[++pos];
+            }
+            else {
+                std::cerr << "unknown opt option " << args[pos] << ", 'help' for more info"
+                    << std::endl;
+                return;
+            }
+        }
+        std::vector<std::shared_ptr<Expense>> expenses = snapshotExpenses();
+        if (!pimpl->optimizer) {
+            pimpl->optimizer = std::make_unique<BalanceOptimizer>();
+            pimpl->optimizer->setExchangeRates(pimpl->rates);
+            pimpl->optimizer->setParticipantIndex(pimpl->index);
+            pimpl->optimizer->setOpeningBalances(pimpl->opening_balances);
+        }
+        if (output.empty()) {
+            if (pimpl->optimizer->optimizeExpenses(expenses, strategy) != OptimizerStatus::SUCCESS) {
+                std::cerr << "optimization failed" << std::endl;
+            }
+            return;
+        }
+
+        //stream the transfers out, the kept result of the last "opt" stays as it is
+        const bool binary = endsWith(output, ".bin");
+        std::ofstream out(output, binary? std::ios::out | std::ios::binary: std::ios::out);
+        if (!out) {
+            std::cerr << "can not open " << output << std::endl;
+            return;
+        }
+        OptimizerStatus status;
+        std::size_t written;
+        if (binary) {
+            BinaryTransferWriter writer(out);
+            status = pimpl->optimizer->exportTransfers(expenses, strategy, writer.sink());
+            written = writer.numOfTransfers();
+        }
+        else {
+            CsvTransferWriter writer(out);
+            status = pimpl->optimizer->exportTransfers(expenses, strategy, writer.sink());
+            written = writer.numOfTransfers();
+        }
+        out.flush();
+        if (status != OptimizerStatus::SUCCESS || !out) {
+            std::cerr << "failed to write the transfers to " << output << std::endl;
+            return;
+        }
+        std::cout << "wrote " << written << " transfers to " << output << std::endl;
+    }
+
 
     //for an expense session add and remove multiple participants
     void Control::addExpParticipants(const std::vector<std::string>& names,
             Expense& expense) const {
-        for (auto& name: names) {
-            if (pimpl->participants.find(name) == pimpl->participants.end()) {
-                std::cerr << name << " is not in the main participants pool" << std::endl;
-                std::cerr << "Aborted" << std::endl;
-                return;
-            }
+        std::size_t missing = pimpl->participants.findMissing(names);
+        if (missing != names.size()) {
+            std::cerr << names[missing] << " is not in the main participants pool" << std::endl;
+            std::cerr << "Aborted" << std::endl;
+            return;
         }
         expense.addParticipant(names);
     }
@@ -183,7 +379,150 @@ namespace AccountBalancer {
     }
 
     void Control::commitExpense(std::shared_ptr<Expense> expense_ptr) {
+        if (!pimpl->rates.hasRate(expense_ptr->getCurrency())) {
+            std::cerr << "no exchange rate for currency " << expense_ptr->getCurrency()
+                << ", expense " << expense_ptr->getNote() << " is not committed" << std::endl;
+            return;
+        }
         pimpl->expense_hist.push_front(expense_ptr);
+        pimpl->balances.addExpense(*expense_ptr, pimpl->rates);
+        pimpl->index->addExpense(expense_ptr);
+        pimpl->last_expense_commit_time = std::chrono::system_clock::now();
+    }
+
+    void Control::settleEpoch(const std::vector<std::string>& args) {
+        if (args.size() != 1) {
+            std::cerr << "settle requires the archive file" << std::endl;
+            return;
+        }
+        mergeSubmitted();
+        std::ofstream archive(args[0], std::ios::app);
+        if (!archive) {
+            std::cerr << "can not open " << args[0] << std::endl;
+            return;
+        }
+        //the transfers of an up to date optimization are taken as executed, without one
+        //every balance is carried forward as it is
+        std::vector<Utils::Debt> executed;
+        if (pimpl->optimizer && pimpl->optimizer->isUpToTime(pimpl->last_expense_commit_time)) {
+            executed = pimpl->optimizer->getTransfers();
+        }
+        const int today = Utils::today();
+        char amount[32];
+        archive << "epoch closed " << Utils::formatDate(today) << ", "
+            << pimpl->expense_hist.size() << " expenses\n";
+        for (auto& opening: pimpl->opening_balances) {
+            snprintf(amount, sizeof(amount), "%.2f", opening.second);
+            archive << "opening " << opening.first << " " << amount << "\n";
+        }
+        //oldest first, every line is date creditor amount currency weights | note
+        for (auto it = pimpl->expense_hist.rbegin(); it != pimpl->expense_hist.rend(); ++it) {
+            const Expense& expense = **it;
+            snprintf(amount, sizeof(amount), "%.2f", expense.getAmount());
+            archive << "expense " << Utils::formatDate(expense.getDate()) << " "
+                << expense.getCreditor() << " " << amount << " "
+                << (expense.getCurrency().empty()? "-": expense.getCurrency());
+            for (auto& weight: expense.getWeightsMap()) {
+                archive << " " << weight.first << ":" << weight.second;
+            }
+            archive << " | " << expense.getNote() << "\n";
+        }
+        std::map<std::string, double> closing;
+        for (auto& balance: pimpl->balances.currentBalances()) {
+            closing[balance.first] = balance.second;
+        }
+        for (auto& transfer: executed) {
+            snprintf(amount, sizeof(amount), "%.2f", transfer.amount);
+            archive << "transfer " << transfer.debtor << " " << transfer.creditor << " "
+                << amount << "\n";
+            closing[transfer.creditor] -= transfer.amount;
+            closing[transfer.debtor] += transfer.amount;
+        }
+        for (auto it = closing.begin(); it != closing.end(); ) {
+            //less than half a cent is settled
+            if (std::abs(it->second) < 0.005) {
+                it = closing.erase(it);
+                continue;
+            }
+            snprintf(amount, sizeof(amount), "%.2f", it->second);
+            archive << "balance " << it->first << " " << amount << "\n";
+            ++it;
+        }
+        archive.flush();
+        //the ledger is only touched once the epoch is safely archived
+        if (!archive) {
+            std::cerr << "failed to write " << args[0] << ", the epoch is kept" << std::endl;
+            return;
+        }
+
+        std::size_t archived = pimpl->expense_hist.size();
+        pimpl->expense_hist.clear();
+        pimpl->index = std::make_shared<ParticipantIndex>();
+        pimpl->balances.clear();
+        for (auto& balance: closing) {
+            pimpl->balances.addBalance(balance.first, today, balance.second);
+        }
+        pimpl->opening_balances.swap(closing);
+        pimpl->opening_day = today;
+        if (pimpl->optimizer) {
+            pimpl->optimizer->setOpeningBalances(pimpl->opening_balances);
+            pimpl->optimizer->setParticipantIndex(pimpl->index);
+        }
+        pimpl->last_expense_commit_time = std::chrono::system_clock::now();
+        std::cout << "archived " << archived << " expenses and " << executed.size()
+            << " transfers to " << args[0] << ", " << pimpl->opening_balances.size()
+            << " balances carried forward" << std::endl;
+    }
+
+    bool Control::setExchangeRates(const ExchangeRates& rates) {
+        if (!pimpl->opening_balances.empty()
+                && rates.getBaseCurrency() != pimpl->rates.getBaseCurrency()) {
+            std::cerr << "the balances carried forward are in " << pimpl->rates.getBaseCurrency()
+                << ", the base currency can not change" << std::endl;
+            return false;
+        }
+        for (auto& expense_ptr: pimpl->expense_hist) {
+            if (!rates.hasRate(expense_ptr->getCurrency())) {
+                std::cerr << "no exchange rate for currency " << expense_ptr->getCurrency()
+                    << ", the exchange rates are not changed" << std::endl;
+                return false;
+            }
+        }
+        pimpl->rates = rates;
+        //the running balances are in the base currency, convert every expense again
+        pimpl->balances.clear();
+        for (auto& opening: pimpl->opening_balances) {
+            pimpl->balances.addBalance(opening.first, pimpl->opening_day, opening.second);
+        }
+        for (auto& expense_ptr: pimpl->expense_hist) {
+            pimpl->balances.addExpense(*expense_ptr, pimpl->rates);
+        }
+        if (pimpl->optimizer) {
+            pimpl->optimizer->setExchangeRates(pimpl->rates);
+        }
+        pimpl->last_expense_commit_time = std::chrono::system_clock::now();
+        //submitted expenses are committed with the new rates
+        mergeSubmitted();
+        return true;
+    }
+
+    void Control::submitExpense(std::shared_ptr<Expense> expense_ptr) {
+        pimpl->submitted.push(std::move(expense_ptr));
+    }
+
+    void Control::mergeSubmitted() {
+        if (pimpl->submitted.size() == 0)   return;
+        std::vector<std::shared_ptr<Expense>> expenses;
+        pimpl->submitted.drain(expenses);
+        for (auto& expense_ptr: expenses) {
+            commitExpense(expense_ptr);
+        }
+    }
+
+    std::vector<std::shared_ptr<Expense>> Control::snapshotExpenses() {
+        mergeSubmitted();
+        return std::vector<std::shared_ptr<Expense>>(pimpl->expense_hist.begin(),
+                pimpl->expense_hist.end());
     }
 
     void Control::control_main() {
@@ -192,12 +531,51 @@ namespace AccountBalancer {
         while (run) {
             std::cout << std::endl;
             std::cout << main_menu_title << std::endl;
-            std::getline(std::cin, input);
-            std::vector<std::string> tokens = Utils::splitLine(input);
-            //TODO
+            if (!std::getline(std::cin, input))   break;
+            run = runCommand(Utils::splitLine(input));
         } 
     }
 
+    bool Control::runCommand(const std::vector<std::string>& tokens) {
+        if (tokens.empty()) return true;
+        auto found = commands_main_map.find(tokens[0]);
+        if (found == commands_main_map.end()) {
+            std::cerr << tokens[0] << " is not a command, 'help' for more info" << std::endl;
+            return true;
+        }
+        const std::vector<std::string> args(tokens.begin() + 1, tokens.end());
+        const bool folks = !args.empty() && args[0] == "-p";
+        switch (found->second) {
+            case CommandMain::ADD:
+                //TODO the expense session of -e and -a
+                if (folks)  addFolks(std::vector<std::string>(args.begin() + 1, args.end()));
+                else    std::cerr << "only add -p is supported yet" << std::endl;
+                break;
+            case CommandMain::RM:
+                if (folks)  removeFolks(std::vector<std::string>(args.begin() + 1, args.end()));
+                else    std::cerr << "only rm -p is supported yet" << std::endl;
+                break;
+            case CommandMain::SHOW:
+                showMain(args);
+                break;
+            case CommandMain::OPT:
+                optimizeMain(args);
+                break;
+            case CommandMain::UNDO:
+                undoExpense();
+                break;
+            case CommandMain::SETTLE:
+                settleEpoch(args);
+                break;
+            case CommandMain::HELP:
+                std::cout << "see Readme.md for the commands and their options" << std::endl;
+                break;
+            case CommandMain::QUIT:
+                return false;
+        }
+        return true;
+    }
+
 
     void Control::control_expense(std::shared_ptr<Expense> expense_ptr) {
         std::cout << "============== Expense session ================" << std::endl;
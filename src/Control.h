@@ -6,6 +6,7 @@
 #include <memory>
 #include <vector>
 #include "Expense.h"
+#include "Currency.h"
 
 namespace AccountBalancer {
     //this is a singleton
@@ -22,12 +23,32 @@ namespace AccountBalancer {
         void addFolks(const std::vector<std::string>&);
         void removeFolks(const std::vector<std::string>&);
 
-        bool validateParticipant(const std::set<std::string>&);
+        bool validateParticipant(const std::vector<std::string>&) const;
         void printFolks() const;
 
+        //print the expense breakdown of the given participants
+        void printParticipantExpenses(const std::vector<std::string>&) const;
+
+        //print the raw debts of the committed expenses, before any optimization
+        void printDebts(const std::vector<std::string>&) const;
+
+        //print everyone's net balance as of a date, or the change between two dates
+        void printBalances(const std::vector<std::string>&) const;
+
+        //print the k people owed the most and the k people owing the most
+        void printTopBalances(const std::vector<std::string>&) const;
+
+        //print the transfers of the given participants (everyone's if no name is given)
+        //as found by the last "opt", which has to be newer than the last commit
+        void printTransfers(const std::vector<std::string>&) const;
+
         //the main menu show option
         void showMain(const std::vector<std::string>&);
 
+        //the main menu opt option, -l, -e and -s pick the strategy, -o writes the transfers to
+        //a file instead, in the binary format if the file name ends in .bin, csv otherwise
+        void optimizeMain(const std::vector<std::string>&);
+
         void showExp(const std::vector<std::string>&);
 
         void addExpParticipants(const std::vector<std::string>&, Expense&) const;
@@ -36,6 +57,17 @@ namespace AccountBalancer {
 
         void commitExpense(std::shared_ptr<Expense> expense_ptr);
 
+        //close the epoch: append its expenses, the transfers of an up to date optimization
+        //(taken as executed) and the closing balances to the archive file, then replace the
+        //expenses by a single balance carried forward per participant
+        void settleEpoch(const std::vector<std::string>&);
+
+        //commit everything submitted from other threads so far
+        void mergeSubmitted();
+
+        //the committed expenses, newest first, after merging the submitted ones
+        std::vector<std::shared_ptr<Expense>> snapshotExpenses();
+
     public:
         Control(const Control&) = delete;
         Control& operator=(const Control) = delete;
@@ -48,8 +80,21 @@ namespace AccountBalancer {
         //controls
         void control_main();
 
+        //run the main menu command of one input line, return false once it is quit
+        bool runCommand(const std::vector<std::string>& tokens);
+
         void control_expense(std::shared_ptr<Expense>);
 
+        //the exchange rates of the ledger, the running balances of the committed expenses
+        //are converted again, false (the rates are not changed) if a committed expense is in
+        //a currency without a rate, or if the base currency changes after a settle
+        //an expense in a currency without a rate is not committed
+        bool setExchangeRates(const ExchangeRates& rates);
+
+        //commit an expense from any thread, e.g. card feed workers, it shows up in the
+        //ledger the next time the main menu reads it (show, opt or undo)
+        void submitExpense(std::shared_ptr<Expense> expense_ptr);
+
     };
 }
 #endif
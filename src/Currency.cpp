@@ -0,0 +1,34 @@
+//implement the exchange rates table
+#include "Currency.h"
+
+namespace AccountBalancer {
+    ExchangeRates::ExchangeRates(const std::string& _base): base(_base) {}
+
+    const std::string& ExchangeRates::getBaseCurrency() const noexcept {
+        return base;
+    }
+
+    void ExchangeRates::setRate(const std::string& currency, double rate) {
+        rates[currency] = rate;
+    }
+
+    bool ExchangeRates::isBase(const std::string& currency) const noexcept {
+        return currency.empty() || currency == base;
+    }
+
+    bool ExchangeRates::hasRate(const std::string& currency) const {
+        return isBase(currency) || rates.find(currency) != rates.end();
+    }
+
+    double ExchangeRates::getRate(const std::string& currency) const {
+        return isBase(currency)? 1.0: rates.at(currency);
+    }
+
+    double ExchangeRates::toBase(double amount, const std::string& currency) const {
+        return amount * getRate(currency);
+    }
+
+    double ExchangeRates::fromBase(double amount, const std::string& currency) const {
+        return amount / getRate(currency);
+    }
+} //AccountBalancer
@@ -0,0 +1,33 @@
+//Exchange rates of a ledger, every rate converts one currency into the base currency
+//an empty currency code always means the base currency
+#ifndef __BALANCE_CURRENCY_H
+#define __BALANCE_CURRENCY_H
+#include <string>
+#include <unordered_map>
+
+namespace AccountBalancer {
+    class ExchangeRates {
+    public:
+        explicit ExchangeRates(const std::string& _base = "");
+
+        const std::string& getBaseCurrency() const noexcept;
+
+        //rate is how much base currency one unit of the given currency is worth
+        void setRate(const std::string& currency, double rate);
+
+        bool hasRate(const std::string& currency) const;
+
+        //throw std::out_of_range if the currency is unknown
+        double getRate(const std::string& currency) const;
+
+        double toBase(double amount, const std::string& currency) const;
+        double fromBase(double amount, const std::string& currency) const;
+
+    private:
+        std::string base;
+        std::unordered_map<std::string, double> rates;
+
+        bool isBase(const std::string& currency) const noexcept;
+    };
+} //AccountBalancer
+#endif
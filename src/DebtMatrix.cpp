@@ -0,0 +1,144 @@
+//implement the pairwise debt matrix
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+#include "DebtMatrix.h"
+
+namespace AccountBalancer {
+    DebtMatrix::DebtMatrix(const std::vector<std::shared_ptr<Expense>>& expenses,
+            const ExchangeRates& rates) {
+        //collect [debtor, creditor, amount] triplets, no strings are copied
+        struct Triplet {
+            int debtor;
+            int creditor;
+            double amount;
+        };
+        std::vector<Triplet> triplets;
+        for (auto& expense: expenses) {
+            int weight_sum = expense->getWeightSum();
+            if (!weight_sum)    continue;
+            if (!rates.hasRate(expense->getCurrency())) {
+                std::cerr << "ignore " << expense->getNote() << " for there is no exchange rate for "
+                    << expense->getCurrency() << std::endl;
+                continue;
+            }
+            int creditor = names.intern(expense->getCreditor());
+            double amount = rates.toBase(expense->getAmount(), expense->getCurrency());
+            double unit = amount / static_cast<double>(weight_sum);
+            for (auto& weight: expense->getWeightsMap()) {
+                int debtor = names.intern(weight.first);
+                //nobody owes themselves
+                if (debtor == creditor) continue;
+                triplets.push_back(Triplet{debtor, creditor, unit * weight.second});
+            }
+        }
+
+        //counting sort the triplets into rows
+        const int n = names.size();
+        row_begin.assign(n + 1, 0);
+        for (auto& triplet: triplets) {
+            ++row_begin[triplet.debtor + 1];
+        }
+        for (int row = 0; row < n; ++row) {
+            row_begin[row + 1] += row_begin[row];
+        }
+        std::vector<std::pair<int, double>> entries(triplets.size());
+        std::vector<int> fill(row_begin.begin(), row_begin.end() - 1);
+        for (auto& triplet: triplets) {
+            entries[fill[triplet.debtor]++] = std::make_pair(triplet.creditor, triplet.amount);
+        }
+
+        //sort each row by creditor and merge the duplicates
+        cols.reserve(entries.size());
+        values.reserve(entries.size());
+        int write_begin = 0;
+        for (int row = 0; row < n; ++row) {
+            auto first = entries.begin() + row_begin[row], last = entries.begin() + row_begin[row + 1];
+            std::sort(first, last, [] (const std::pair<int, double>& e1,
+                        const std::pair<int, double>& e2) -> bool {
+                    return e1.first < e2.first;
+                    });
+            row_begin[row] = write_begin;
+            for (auto it = first; it != last; ++it) {
+                if (static_cast<int>(cols.size()) > write_begin && cols.back() == it->first) {
+                    values.back() += it->second;
+                }
+                else {
+                    cols.push_back(it->first);
+                    values.push_back(it->second);
+                }
+            }
+            write_begin = cols.size();
+        }
+        row_begin[n] = write_begin;
+    }
+
+    double DebtMatrix::owed(int debtor, int creditor) const {
+        auto first = cols.begin() + row_begin[debtor], last = cols.begin() + row_begin[debtor + 1];
+        auto it = std::lower_bound(first, last, creditor);
+        if (it == last || *it != creditor)  return 0.0;
+        return values[it - cols.begin()];
+    }
+
+    double DebtMatrix::owed(const std::string& debtor, const std::string& creditor) const {
+        int debtor_id = names.find(debtor), creditor_id = names.find(creditor);
+        if (debtor_id < 0 || creditor_id < 0)   return 0.0;
+        return owed(debtor_id, creditor_id);
+    }
+
+    double DebtMatrix::net(const std::string& a, const std::string& b) const {
+        return owed(a, b) - owed(b, a);
+    }
+
+    std::vector<std::pair<std::string, double>> DebtMatrix::creditorsOf(const std::string& debtor) const {
+        std::vector<std::pair<std::string, double>> res;
+        int row = names.find(debtor);
+        if (row < 0)    return res;
+        for (int pos = row_begin[row]; pos < row_begin[row + 1]; ++pos) {
+            res.push_back(std::make_pair(names.name(cols[pos]), values[pos]));
+        }
+        return res;
+    }
+
+    std::vector<Utils::Debt> DebtMatrix::nettedDebts() const {
+        std::vector<Utils::Debt> res;
+        for (int row = 0; row < names.size(); ++row) {
+            for (int pos = row_begin[row]; pos < row_begin[row + 1]; ++pos) {
+                //only keep the direction that still owes after netting
+                double amount = values[pos] - owed(cols[pos], row);
+                if (Utils::isGreater(amount, 0.0)) {
+                    res.push_back(Utils::Debt(names.name(cols[pos]), names.name(row), amount));
+                }
+            }
+        }
+        return res;
+    }
+
+    void DebtMatrix::printReport(const std::vector<std::string>& filter) const {
+        const std::set<std::string> wanted(filter.begin(), filter.end());
+        std::vector<Utils::Debt> debts = nettedDebts();
+        std::sort(debts.begin(), debts.end(), [] (const Utils::Debt& d1, const Utils::Debt& d2) -> bool {
+                return d1.debtor != d2.debtor? d1.debtor < d2.debtor: d1.creditor < d2.creditor;
+                });
+        std::cout << "Debts before optimization (bilaterally netted)" << std::endl;
+        bool printed = false;
+        for (auto& debt: debts) {
+            if (!wanted.empty() && !wanted.count(debt.debtor) && !wanted.count(debt.creditor))
+                continue;
+            printf("%-20s owes %20s   $%-.2f\n", debt.debtor.c_str(), debt.creditor.c_str(), debt.amount);
+            printed = true;
+        }
+        if (!printed) {
+            std::cout << "No Debts" << std::endl;
+        }
+    }
+
+    int DebtMatrix::numOfEntries() const noexcept {
+        return cols.size();
+    }
+
+    const NameTable& DebtMatrix::getNames() const noexcept {
+        return names;
+    }
+} //AccountBalancer
@@ -0,0 +1,52 @@
+//A sparse pairwise matrix of the raw debts in a ledger (before optimization)
+//rows are debtors and columns are creditors, both indexed by interned participant IDs,
+//stored in compressed sparse row (CSR) format
+#ifndef __BALANCE_DEBT_MATRIX_H
+#define __BALANCE_DEBT_MATRIX_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Currency.h"
+#include "Expense.h"
+#include "NameTable.h"
+#include "utils.h"
+
+namespace AccountBalancer {
+    class DebtMatrix {
+    public:
+        //build the matrix in a single pass over the expenses, amounts in base currency
+        explicit DebtMatrix(const std::vector<std::shared_ptr<Expense>>& expenses,
+                const ExchangeRates& rates = ExchangeRates());
+
+        //how much debtor owes creditor, summing up all the shared expenses
+        double owed(const std::string& debtor, const std::string& creditor) const;
+
+        //bilateral netting, positive if a owes b after b's debt to a is deducted
+        double net(const std::string& a, const std::string& b) const;
+
+        //all the [creditor, amount] this debtor owes
+        std::vector<std::pair<std::string, double>> creditorsOf(const std::string& debtor) const;
+
+        //all the bilaterally netted debts, at most one per pair of participants
+        std::vector<Utils::Debt> nettedDebts() const;
+
+        //print the netted debts involving the given names, everyone if no names are given
+        void printReport(const std::vector<std::string>& names) const;
+
+        //number of non-zero [debtor, creditor] entries
+        int numOfEntries() const noexcept;
+
+        const NameTable& getNames() const noexcept;
+
+    private:
+        NameTable names;
+        //row i spans [row_begin[i], row_begin[i + 1]) in cols and values
+        std::vector<int> row_begin;
+        std::vector<int> cols;
+        std::vector<double> values;
+
+        double owed(int debtor, int creditor) const;
+    };
+} //AccountBalancer
+#endif
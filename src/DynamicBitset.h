@@ -0,0 +1,140 @@
+//A bitset whose size is decided at runtime
+//set, test, iteration and shifts work a 64-bit word at a time
+#ifndef __BALANCE_DYNAMIC_BITSET_H
+#define __BALANCE_DYNAMIC_BITSET_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace AccountBalancer {
+    class DynamicBitset {
+    public:
+        using Word = std::uint64_t;
+        static constexpr std::size_t word_bits = 64;
+
+        explicit DynamicBitset(std::size_t _size = 0):
+            num_bits(_size),
+            words((_size + word_bits - 1) / word_bits, 0) {}
+
+        std::size_t size() const noexcept {
+            return num_bits;
+        }
+
+        //grow or shrink, new bits are cleared
+        void resize(std::size_t _size) {
+            num_bits = _size;
+            words.resize((_size + word_bits - 1) / word_bits, 0);
+            clearTail();
+        }
+
+        void set(std::size_t pos) {
+            words[pos / word_bits] |= Word(1) << (pos % word_bits);
+        }
+
+        void reset(std::size_t pos) {
+            words[pos / word_bits] &= ~(Word(1) << (pos % word_bits));
+        }
+
+        void reset() noexcept {
+            std::fill(words.begin(), words.end(), 0);
+        }
+
+        bool test(std::size_t pos) const {
+            return (words[pos / word_bits] >> (pos % word_bits)) & 1;
+        }
+
+        std::size_t count() const noexcept {
+            std::size_t res = 0;
+            for (Word word: words) {
+                res += __builtin_popcountll(word);
+            }
+            return res;
+        }
+
+        bool any() const noexcept {
+            for (Word word: words) {
+                if (word)   return true;
+            }
+            return false;
+        }
+
+        bool none() const noexcept {
+            return !any();
+        }
+
+        //the first set bit at or after pos, size() if there is none
+        std::size_t findNext(std::size_t pos) const {
+            if (pos >= num_bits)    return num_bits;
+            std::size_t index = pos / word_bits;
+            Word word = words[index] & (~Word(0) << (pos % word_bits));
+            while (true) {
+                if (word)   return index * word_bits + __builtin_ctzll(word);
+                if (++index == words.size())    return num_bits;
+                word = words[index];
+            }
+        }
+
+        std::size_t findFirst() const {
+            return findNext(0);
+        }
+
+        //word-parallel set operations, both bitsets must have the same size
+        DynamicBitset& operator&=(const DynamicBitset& other) {
+            for (std::size_t index = 0; index < words.size(); ++index) {
+                words[index] &= other.words[index];
+            }
+            return *this;
+        }
+
+        DynamicBitset& operator|=(const DynamicBitset& other) {
+            for (std::size_t index = 0; index < words.size(); ++index) {
+                words[index] |= other.words[index];
+            }
+            return *this;
+        }
+
+        //this |= other << shift, bits shifted past size() are dropped,
+        //other may be this bitset itself
+        DynamicBitset& orShifted(const DynamicBitset& other, std::size_t shift) {
+            std::size_t word_shift = shift / word_bits, bit_shift = shift % word_bits;
+            //from the top down, so the words still to be read are not overwritten yet
+            for (std::size_t index = words.size(); index-- > word_shift; ) {
+                std::size_t from = index - word_shift;
+                Word word = other.words[from] << bit_shift;
+                if (bit_shift && from > 0)  word |= other.words[from - 1] >> (word_bits - bit_shift);
+                words[index] |= word;
+            }
+            clearTail();
+            return *this;
+        }
+
+        //every bit of this bitset is set in other as well, sizes may differ
+        bool isSubsetOf(const DynamicBitset& other) const {
+            for (std::size_t index = 0; index < words.size(); ++index) {
+                Word theirs = index < other.words.size()? other.words[index]: 0;
+                if (words[index] & ~theirs) return false;
+            }
+            return true;
+        }
+
+        bool intersects(const DynamicBitset& other) const {
+            std::size_t common = std::min(words.size(), other.words.size());
+            for (std::size_t index = 0; index < common; ++index) {
+                if (words[index] & other.words[index])  return true;
+            }
+            return false;
+        }
+
+    private:
+        std::size_t num_bits;
+        std::vector<Word> words;
+
+        void clearTail() {
+            if (num_bits % word_bits) {
+                words.back() &= (Word(1) << (num_bits % word_bits)) - 1;
+            }
+        }
+    };
+} //AccountBalancer
+#endif
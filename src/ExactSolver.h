@@ -0,0 +1,419 @@
+//Exact least transfer solvers, specialized at compile time on the maximum number of gaps
+//balances live in fixed-size arrays and participant sets are machine word masks
+//  ExactSolver<8>, ExactSolver<16>: dynamic programming over all the subsets
+//  ExactSolver<32>, ExactSolver<64>: depth-first branch and bound with a node budget
+//both minimize the number of transfers, which is the number of gaps minus the maximum
+//number of groups that settle among themselves (zero-sum groups)
+//the branch and bound can also run on a WorkStealingPool, the top of the search tree is
+//split into a fixed number of tasks, run in waves which pass the best transfer count found
+//so far on to the next wave as its bound
+#ifndef __BALANCE_EXACT_SOLVER_H
+#define __BALANCE_EXACT_SOLVER_H
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "WorkStealingPool.h"
+
+namespace AccountBalancer {
+    //a single transfer of a plan, from and to are indices into the solver's balances
+    struct Settlement {
+        int from;
+        int to;
+        long long cents;
+    };
+
+    namespace SolverDetail {
+        template <std::size_t N> struct MaskWord;
+        template <> struct MaskWord<8> { using type = std::uint8_t; };
+        template <> struct MaskWord<16> { using type = std::uint16_t; };
+        template <> struct MaskWord<32> { using type = std::uint32_t; };
+        template <> struct MaskWord<64> { using type = std::uint64_t; };
+
+        //popcount and lowest set bit of every byte, generated at compile time
+        struct ByteTables {
+            unsigned char popcount[256];
+            unsigned char lowest[256];
+
+            constexpr ByteTables(): popcount(), lowest() {
+                for (int byte = 1; byte < 256; ++byte) {
+                    popcount[byte] = (byte & 1) + popcount[byte >> 1];
+                    int bit = 0;
+                    while (!((byte >> bit) & 1)) ++bit;
+                    lowest[byte] = bit;
+                }
+                lowest[0] = 8;
+            }
+        };
+
+        constexpr ByteTables byte_tables{};
+
+        template <typename Mask>
+        inline int popcount(Mask mask) {
+            int count = 0;
+            for (std::size_t byte = 0; byte < sizeof(Mask); ++byte) {
+                count += byte_tables.popcount[(mask >> (8 * byte)) & 0xff];
+            }
+            return count;
+        }
+
+        //mask must not be zero
+        template <typename Mask>
+        inline int lowestBit(Mask mask) {
+            for (std::size_t byte = 0; ; ++byte) {
+                unsigned low = (mask >> (8 * byte)) & 0xff;
+                if (low)    return 8 * byte + byte_tables.lowest[low];
+            }
+        }
+
+        template <typename Mask>
+        inline Mask bit(int pos) {
+            return static_cast<Mask>(Mask(1) << pos);
+        }
+    } //SolverDetail
+
+    template <std::size_t N>
+    class ExactSolver {
+        static_assert(N == 8 || N == 16 || N == 32 || N == 64, "unsupported solver width");
+    public:
+        using Mask = typename SolverDetail::MaskWord<N>::type;
+
+        //balances in cents, positive means being owed, they must sum up to zero
+        ExactSolver(const long long* balances, int _n): n(_n), plan_size(0),
+                nodes_left(0), out_of_nodes(false) {
+            std::copy(balances, balances + n, balance.begin());
+        }
+
+        //find the plan, return false if the node budget ran out before the optimum
+        //is proven, in which case the best plan found so far is kept
+        bool solve(std::size_t node_budget) {
+            plan_size = 0;
+            return solve(node_budget, std::integral_constant<bool, (N <= 16)>());
+        }
+
+        //same as above with the branch and bound spread over the pool, the plan is the
+        //same as the single-threaded one unless the node budget runs out, and it never
+        //depends on the number of threads of the pool or on their timing, even then
+        bool solve(std::size_t node_budget, const WorkStealingPool& pool) {
+            plan_size = 0;
+            return solve(node_budget, pool, std::integral_constant<bool, (N <= 16)>());
+        }
+
+        int numOfTransfers() const noexcept {
+            return plan_size;
+        }
+
+        const Settlement* begin() const noexcept {
+            return plan.data();
+        }
+
+        const Settlement* end() const noexcept {
+            return plan.data() + plan_size;
+        }
+
+    private:
+        int n;
+        std::array<long long, N> balance;
+        //a plan never needs more than n - 1 transfers
+        std::array<Settlement, N> plan;
+        int plan_size;
+
+        //branch and bound state
+        std::array<Settlement, N> path;
+        std::size_t nodes_left;
+        bool out_of_nodes;
+
+        //the pool search splits the tree into about this many tasks and runs them
+        //wave_tasks at a time, both fixed so that the plan does not depend on the pool
+        static constexpr std::size_t split_tasks = 128;
+        static constexpr std::size_t wave_tasks = 32;
+
+        //a sub-tree of the search left to a worker
+        struct Task {
+            Mask open;
+            int depth;
+            std::array<long long, N> balance;
+            std::array<Settlement, N> path;
+        };
+
+        long long sumOf(Mask mask) const {
+            long long sum = 0;
+            while (mask) {
+                int pos = SolverDetail::lowestBit(mask);
+                sum += balance[pos];
+                mask &= mask - 1;
+            }
+            return sum;
+        }
+
+        //settle a zero-sum group with at most size - 1 transfers
+        void settleGroup(Mask group) {
+            std::array<int, N> creditors, debtors;
+            std::array<long long, N> left;
+            int num_creditors = 0, num_debtors = 0;
+            for (Mask rest = group; rest; rest &= rest - 1) {
+                int pos = SolverDetail::lowestBit(rest);
+                left[pos] = balance[pos];
+                if (balance[pos] > 0)   creditors[num_creditors++] = pos;
+                else if (balance[pos] < 0)  debtors[num_debtors++] = pos;
+            }
+            int c = 0, d = 0;
+            while (c < num_creditors && d < num_debtors) {
+                int creditor = creditors[c], debtor = debtors[d];
+                long long amount = std::min(left[creditor], -left[debtor]);
+                plan[plan_size++] = Settlement{debtor, creditor, amount};
+                left[creditor] -= amount;
+                left[debtor] += amount;
+                if (!left[creditor])    ++c;
+                if (!left[debtor])  ++d;
+            }
+        }
+
+        //dynamic programming over the subsets, groups[mask] is the maximum number of
+        //zero-sum groups mask can be split into, removing one member at a time
+        bool solve(std::size_t, std::true_type) {
+            using Index = std::uint32_t;
+            const Index full = (Index(1) << n) - 1;
+            std::array<unsigned char, (std::size_t(1) << (N <= 16? N: 0))> groups;
+            groups[0] = 0;
+            for (Index mask = 1; mask <= full; ++mask) {
+                unsigned char best = 0;
+                for (Index rest = mask; rest; rest &= rest - 1) {
+                    best = std::max(best, groups[mask & ~(rest & (~rest + 1))]);
+                }
+                groups[mask] = best + (sumOf(static_cast<Mask>(mask)) == 0);
+            }
+            //walk back, every zero-sum mask on the way closes a group
+            Index mask = full;
+            Mask group = 0;
+            while (mask) {
+                int target = groups[mask] - (sumOf(static_cast<Mask>(mask)) == 0);
+                for (Index rest = mask; rest; rest &= rest - 1) {
+                    Index low = rest & (~rest + 1);
+                    if (groups[mask & ~low] == target) {
+                        mask &= ~low;
+                        group |= static_cast<Mask>(low);
+                        break;
+                    }
+                }
+                if (sumOf(static_cast<Mask>(mask)) == 0) {
+                    settleGroup(group);
+                    group = 0;
+                }
+            }
+            return true;
+        }
+
+        //branch and bound, settle the first open balance against every candidate
+        bool solve(std::size_t node_budget, std::false_type) {
+            Mask open = 0;
+            for (int pos = 0; pos < n; ++pos) {
+                if (balance[pos])   open |= SolverDetail::bit<Mask>(pos);
+            }
+            //the first descent always reaches a complete plan
+            nodes_left = std::max<std::size_t>(node_budget, n + 1);
+            out_of_nodes = false;
+            int best = n;
+            search(open, 0, best);
+            regroup();
+            return !out_of_nodes;
+        }
+
+        bool solve(std::size_t node_budget, const WorkStealingPool&, std::true_type) {
+            return solve(node_budget, std::true_type());
+        }
+
+        bool solve(std::size_t node_budget, const WorkStealingPool& pool, std::false_type) {
+            Mask open = 0;
+            for (int pos = 0; pos < n; ++pos) {
+                if (balance[pos])   open |= SolverDetail::bit<Mask>(pos);
+            }
+            //go deeper until there are enough tasks to keep a wave busy,
+            //the tasks are in the order the single-threaded search visits them
+            std::vector<Task> tasks;
+            for (int split_depth = 1; split_depth < n; ++split_depth) {
+                std::vector<Task> deeper;
+                collectTasks(open, 0, split_depth, deeper);
+                bool grown = deeper.size() > tasks.size();
+                tasks.swap(deeper);
+                if (!grown || tasks.size() >= split_tasks)  break;
+            }
+
+            //a task only sees the best count of the waves before its own and a node budget
+            //fixed before its wave starts, so whatever it finds is the same on every run
+            int best_count = n;
+            std::size_t nodes = std::max<std::size_t>(node_budget, n + 1);
+            std::vector<int> counts(tasks.size(), std::numeric_limits<int>::max());
+            std::vector<std::array<Settlement, N>> plans(tasks.size());
+            std::vector<std::size_t> used(tasks.size(), 0);
+            std::vector<char> out(tasks.size(), 0);
+            std::vector<std::size_t> pending(tasks.size());
+            for (std::size_t index = 0; index < tasks.size(); ++index) {
+                pending[index] = index;
+            }
+            //the tasks that ran out of nodes are searched again with the nodes the others
+            //left, as long as every one of them gets more than in the round before
+            std::size_t last_share = 0;
+            while (!pending.empty() && nodes / pending.size() > last_share) {
+                last_share = nodes / pending.size();
+                for (std::size_t first = 0; first < pending.size(); first += wave_tasks) {
+                    const std::size_t last = std::min(pending.size(), first + wave_tasks);
+                    //an even share of the nodes left, what a wave leaves goes to the next ones
+                    const std::size_t share = std::max<std::size_t>(nodes / (pending.size() - first), n + 1);
+                    const int bound = std::min(n, best_count + 1);
+                    pool.run(last - first, [&] (std::size_t offset) {
+                        const std::size_t index = pending[first + offset];
+                        const Task& task = tasks[index];
+                        ExactSolver worker(*this);
+                        worker.balance = task.balance;
+                        worker.path = task.path;
+                        worker.plan_size = 0;
+                        worker.nodes_left = share;
+                        worker.out_of_nodes = false;
+                        //ties with the best count of earlier waves are still searched, so the
+                        //first task holding an optimal plan always finds it
+                        int best = bound;
+                        worker.search(task.open, task.depth, best);
+                        if (worker.plan_size && worker.plan_size < counts[index]) {
+                            counts[index] = worker.plan_size;
+                            plans[index] = worker.plan;
+                        }
+                        used[index] = share - worker.nodes_left;
+                        out[index] = worker.out_of_nodes;
+                    });
+                    for (std::size_t pos = first; pos < last; ++pos) {
+                        nodes -= std::min(nodes, used[pending[pos]]);
+                        best_count = std::min(best_count, counts[pending[pos]]);
+                    }
+                }
+                std::vector<std::size_t> exhausted;
+                for (std::size_t index: pending) {
+                    if (out[index]) exhausted.push_back(index);
+                }
+                pending.swap(exhausted);
+            }
+            const bool exhausted = !pending.empty();
+
+            //the lowest count, the earliest task on a tie, as the single-threaded search
+            std::size_t chosen = std::min_element(counts.begin(), counts.end()) - counts.begin();
+            if (chosen < counts.size() && counts[chosen] != std::numeric_limits<int>::max()) {
+                std::copy(plans[chosen].begin(), plans[chosen].begin() + counts[chosen], plan.begin());
+                plan_size = counts[chosen];
+            }
+            regroup();
+            return !exhausted;
+        }
+
+        //walk the search tree down to split_depth and save the open sub-trees as tasks
+        void collectTasks(Mask open, int depth, int split_depth, std::vector<Task>& tasks) {
+            if (!open || depth == split_depth) {
+                tasks.push_back(Task{open, depth, balance, path});
+                return;
+            }
+            if (depth + (SolverDetail::popcount(open) + 1) / 2 >= n) return;
+            branch(open, depth, [this, split_depth, &tasks] (Mask rest, int next_depth) {
+                collectTasks(rest, next_depth, split_depth, tasks);
+            });
+        }
+
+        //the connected parts of a plan are zero-sum groups, settle every one of them again
+        //with greedy matching, which keeps the number of transfers and moves the least money
+        void regroup() {
+            std::array<int, N> parent;
+            for (int pos = 0; pos < n; ++pos)   parent[pos] = pos;
+            auto find = [&parent] (int pos) -> int {
+                while (parent[pos] != pos) {
+                    parent[pos] = parent[parent[pos]];
+                    pos = parent[pos];
+                }
+                return pos;
+            };
+            for (int pos = 0; pos < plan_size; ++pos) {
+                parent[find(plan[pos].from)] = find(plan[pos].to);
+            }
+            std::array<Mask, N> groups;
+            std::fill(groups.begin(), groups.end(), Mask(0));
+            for (int pos = 0; pos < n; ++pos) {
+                if (balance[pos])   groups[find(pos)] |= SolverDetail::bit<Mask>(pos);
+            }
+            plan_size = 0;
+            for (int pos = 0; pos < n; ++pos) {
+                if (groups[pos])    settleGroup(groups[pos]);
+            }
+        }
+
+        bool takeNode() {
+            if (!nodes_left) {
+                out_of_nodes = true;
+                return false;
+            }
+            --nodes_left;
+            return true;
+        }
+
+        void search(Mask open, int depth, int& best) {
+            if (!takeNode())    return;
+            if (!open) {
+                if (depth < best) {
+                    best = depth;
+                    std::copy(path.begin(), path.begin() + depth, plan.begin());
+                    plan_size = depth;
+                }
+                return;
+            }
+            //every transfer closes at most two balances
+            if (depth + (SolverDetail::popcount(open) + 1) / 2 >= best) return;
+            branch(open, depth, [this, &best] (Mask rest, int next_depth) {
+                search(rest, next_depth, best);
+            });
+        }
+
+        //call next(rest, depth + 1) on every way to settle the first open balance,
+        //with the balances and the path updated for the duration of the call
+        template <typename Next>
+        void branch(Mask open, int depth, Next&& next) {
+            int start = SolverDetail::lowestBit(open);
+            long long amount = balance[start];
+            Mask rest = open & ~SolverDetail::bit<Mask>(start);
+            //an exact counterpart is always an optimal choice
+            for (Mask candidates = rest; candidates; candidates &= candidates - 1) {
+                int pos = SolverDetail::lowestBit(candidates);
+                if (balance[pos] == -amount) {
+                    settle(start, pos, amount, depth);
+                    balance[pos] = 0;
+                    next(rest & ~SolverDetail::bit<Mask>(pos), depth + 1);
+                    balance[pos] = -amount;
+                    return;
+                }
+            }
+            for (Mask candidates = rest; candidates; candidates &= candidates - 1) {
+                int pos = SolverDetail::lowestBit(candidates);
+                if ((balance[pos] > 0) == (amount > 0)) continue;
+                //candidates with the same balance lead to the same sub-problems
+                bool tried = false;
+                for (Mask before = rest & (SolverDetail::bit<Mask>(pos) - 1); before; before &= before - 1) {
+                    if (balance[SolverDetail::lowestBit(before)] == balance[pos]) {
+                        tried = true;
+                        break;
+                    }
+                }
+                if (tried)  continue;
+                settle(start, pos, amount, depth);
+                balance[pos] += amount;
+                next(rest, depth + 1);
+                balance[pos] -= amount;
+                if (out_of_nodes)   return;
+            }
+        }
+
+        //move the whole balance of start onto pos
+        void settle(int start, int pos, long long amount, int depth) {
+            path[depth] = amount > 0? Settlement{pos, start, amount}: Settlement{start, pos, -amount};
+        }
+    };
+} //AccountBalancer
+#endif
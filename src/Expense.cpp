@@ -1,14 +1,19 @@
 //implement the expense class
 //Created by Theodore Yang on 1/4/2017
 
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <sstream>
 #include "Expense.h"
+#include "NameTable.h"
 namespace {
     constexpr const char* default_note = "no notes";
 
-    constexpr int weight_upper_limit = 999;
+    constexpr int weight_upper_limit = AccountBalancer::Expense::max_weight;
+
+    constexpr std::uint64_t fnv_offset_basis = 14695981039346656037ULL;
+    constexpr std::uint64_t fnv_prime = 1099511628211ULL;
 
     enum CommitType {
         WeightChange,
@@ -56,27 +61,12 @@ namespace AccountBalancer {
                         << " -> " << diff.second.second << ")" << std::endl;
                 }
             }
-            else if (commit.type == CommitType::AddPartic) {
-                for (auto it = commit.diffs.begin(); ; ++it) {
-                    if (it ==commit.diffs.end()) {
-                        std::cout << it->first << std::endl;
-                        break;
-                    }
-                    else {
-                        std::cout << it->first << ", ";
-                    }
-                }
-            }
-            else if (commit.type == CommitType::RemovePartic) {
-                for (auto it = commit.diffs.begin(); ; ++it) {
-                    if (it ==commit.diffs.end()) {
-                        std::cout << it->first << std::endl;
-                        break;
-                    }
-                    else {
-                        std::cout << it->first << ", ";
-                    }
+            else if (commit.type == CommitType::AddPartic
+                    || commit.type == CommitType::RemovePartic) {
+                for (auto it = commit.diffs.begin(); it != commit.diffs.end(); ++it) {
+                    std::cout << (it == commit.diffs.begin()? "  ": ", ") << it->first;
                 }
+                std::cout << std::endl;
             }
             else {
                 std::cout << "undefined commit" << std::endl;
@@ -93,15 +83,37 @@ namespace AccountBalancer {
         creditor(_creditor),
         amount(_amount), 
         note(default_note),
-        total_weight(0){}
+        date(Utils::today()),
+        total_weight(0),
+        split_signature(fnv_offset_basis) {}
 
     Expense::Expense(const std::string& _creditor,
             double _amount,
             const std::string& _note):
         creditor(_creditor),
         amount(_amount),
-        note(_note),
-        total_weight(0){}
+        note(_note.begin(), _note.end()),
+        date(Utils::today()),
+        total_weight(0),
+        split_signature(fnv_offset_basis) {}
+
+    Expense::Expense(const std::string& _creditor,
+            double _amount,
+            MemoryResource* resource):
+        Expense(_creditor, _amount, default_note, resource) {}
+
+    Expense::Expense(const std::string& _creditor,
+            double _amount,
+            const std::string& _note,
+            MemoryResource* resource):
+        creditor(_creditor),
+        amount(_amount),
+        note(_note.begin(), _note.end(), Note::allocator_type(resource)),
+        date(Utils::today()),
+        checkpoint(WeightMap::allocator_type(resource)),
+        weights(WeightMap::allocator_type(resource)),
+        total_weight(0),
+        split_signature(fnv_offset_basis) {}
 
     //dtor
     Expense::~Expense() = default;
@@ -132,14 +144,43 @@ namespace AccountBalancer {
     }
 
     std::string Expense::getNote() const {
-        return note;
+        return std::string(note.begin(), note.end());
+    }
+
+    const std::string& Expense::getCurrency() const noexcept {
+        return currency;
     }
 
-    const std::map<std::string, int>& Expense::getWeightsMap() const {
+    int Expense::getDate() const noexcept {
+        return date;
+    }
+
+    const Expense::WeightMap& Expense::getWeightsMap() const {
         return weights;
     }
 
+    std::uint64_t Expense::getSplitSignature() const noexcept {
+        return split_signature;
+    }
+
+    bool Expense::hasParticipant(int id) const {
+        auto it = std::lower_bound(interned_weights.begin(), interned_weights.end(),
+                std::make_pair(id, 0));
+        return it != interned_weights.end() && it->first == id;
+    }
+
+    const std::vector<std::pair<int, int>>& Expense::getInternedWeights() const noexcept {
+        return interned_weights;
+    }
+
     void Expense::printCommitsHistory(bool verbose) const {
+        if (has_checkpoint) {
+            std::cout << "checkpoint:";
+            for (auto& weight: checkpoint) {
+                std::cout << " " << weight.first << "(" << weight.second << ")";
+            }
+            std::cout << std::endl << std::endl;
+        }
         for (auto& commit: commit_hist) {
             printExpenseCommit(*commit, verbose);
         }
@@ -148,7 +189,10 @@ namespace AccountBalancer {
     void Expense::printExpenseSummary() const {
         printf("%s\n", note.c_str());
         printf("Creditor:  %25s\n", creditor.c_str());
-        printf("Amount:  %27.2f\n", amount);
+        if (currency.empty())
+            printf("Amount:  %27.2f\n", amount);
+        else
+            printf("Amount:  %23.2f %3s\n", amount, currency.c_str());
         std::vector<std::string> weights = formatWeightsString();
         printf("Shared by:  %-42s\n", weights[0].c_str());
         for (int i = 1; i < weights.size(); ++i) {
@@ -157,14 +201,22 @@ namespace AccountBalancer {
     }
 
     //modifiers
-    void Expense::setNote(std::string _note) noexcept {
-        note = std::move(_note);
+    void Expense::setNote(const std::string& _note) {
+        note.assign(_note.begin(), _note.end());
     }
 
     void Expense::setAmount(double _amount) noexcept {
         amount = _amount;
     }
 
+    void Expense::setCurrency(std::string _currency) noexcept {
+        currency = std::move(_currency);
+    }
+
+    void Expense::setDate(int _date) noexcept {
+        date = _date;
+    }
+
     void Expense::addParticipant(const std::vector<std::string>& names) {
         auto commit_ptr(std::make_unique<ExpenseCommit>(CommitType::AddPartic));
         for (auto& name: names) {
@@ -179,7 +231,8 @@ namespace AccountBalancer {
                 }
             }
         }
-        commit_hist.push_back(std::move(commit_ptr));
+        recordCommit(std::move(commit_ptr));
+        refreshDerived();
     }
 
     void Expense::removeParticipant(const std::vector<std::string>& names) {
@@ -198,12 +251,14 @@ namespace AccountBalancer {
                     std::cerr << "ignore " << name << " for it's not in the participants list" << std::endl;
             }
         }
-        commit_hist.push_back(std::move(commit_ptr));
         //make sure there is at least one participant
         if (weights.empty()) {
             std::cerr << "at least one participant has to show up" << std::endl;
-            rollBack();
+            rollBack(*commit_ptr);
+            return;
         }
+        recordCommit(std::move(commit_ptr));
+        refreshDerived();
     }
 
     void Expense::changeWeights(const std::vector<std::pair<std::string, int>>& change_list) {
@@ -230,7 +285,149 @@ namespace AccountBalancer {
             else
                 weights[change.first] = after;
         }
-        commit_hist.push_back(std::move(commit_ptr));
+        recordCommit(std::move(commit_ptr));
+        refreshDerived();
+    }
+
+    void Expense::setHistoryEnabled(bool enabled) noexcept {
+        keep_history = enabled;
+    }
+
+    bool Expense::isHistoryEnabled() const noexcept {
+        return keep_history;
+    }
+
+    void Expense::recordCommit(std::unique_ptr<ExpenseCommit> commit) {
+        if (!keep_history)  return;
+        if (squash_history && !commit_hist.empty() && squashCommits(*commit_hist.back(), *commit)) {
+            if (commit_hist.back()->diffs.empty())  commit_hist.pop_back();
+            return;
+        }
+        commit_hist.push_back(std::move(commit));
+        trimHistory();
+    }
+
+    void Expense::setHistoryPolicy(std::size_t max_depth, bool squash) {
+        max_history = max_depth;
+        squash_history = squash;
+        trimHistory();
+    }
+
+    bool Expense::squashCommits(ExpenseCommit& older, const ExpenseCommit& newer) {
+        std::set<std::string> older_names, newer_names;
+        for (auto& diff: older.diffs)   older_names.insert(diff.first);
+        for (auto& diff: newer.diffs)   newer_names.insert(diff.first);
+        if (older_names != newer_names) return false;
+        //[name, [weight before the older commit, weight after the newer one]]
+        std::map<std::string, std::pair<int, int>> net;
+        auto merge = [&net] (const ExpenseCommit& commit) {
+            for (auto& diff: commit.diffs) {
+                auto found = net.find(diff.first);
+                if (found == net.end()) net.emplace(diff.first, diff.second);
+                else    found->second.second = diff.second.second;
+            }
+        };
+        merge(older);
+        merge(newer);
+        //participants back to where they started stay in, so that the next commit on
+        //them can still be squashed, unless nobody changed at all
+        std::vector<ExpenseCommit::singleDiff> diffs(net.begin(), net.end());
+        bool all_added = true, all_removed = true, any_change = false;
+        for (auto& diff: diffs) {
+            all_added = all_added && !diff.second.first;
+            all_removed = all_removed && !diff.second.second;
+            any_change = any_change || diff.second.first != diff.second.second;
+        }
+        older.type = all_added? CommitType::AddPartic:
+            all_removed? CommitType::RemovePartic: CommitType::WeightChange;
+        if (!any_change)    diffs.clear();
+        older.diffs.swap(diffs);
+        return true;
+    }
+
+    void Expense::trimHistory() {
+        if (!max_history || commit_hist.size() <= max_history)  return;
+        if (!has_checkpoint) {
+            //undo every commit on a copy of the weights to get the state before the oldest
+            checkpoint = weights;
+            for (auto it = commit_hist.rbegin(); it != commit_hist.rend(); ++it) {
+                for (auto& diff: (*it)->diffs) {
+                    if (diff.second.first)  checkpoint[diff.first] = diff.second.first;
+                    else    checkpoint.erase(diff.first);
+                }
+            }
+            has_checkpoint = true;
+        }
+        const std::size_t excess = commit_hist.size() - max_history;
+        for (std::size_t pos = 0; pos < excess; ++pos) {
+            for (auto& diff: commit_hist[pos]->diffs) {
+                if (diff.second.second) checkpoint[diff.first] = diff.second.second;
+                else    checkpoint.erase(diff.first);
+            }
+        }
+        commit_hist.erase(commit_hist.begin(), commit_hist.begin() + excess);
+    }
+
+    std::size_t Expense::compactHistory() {
+        std::size_t before = historyBytes();
+        std::vector<std::unique_ptr<ExpenseCommit>> squashed;
+        for (auto& commit: commit_hist) {
+            if (!squashed.empty() && squashCommits(*squashed.back(), *commit)) {
+                if (squashed.back()->diffs.empty()) squashed.pop_back();
+                continue;
+            }
+            squashed.push_back(std::move(commit));
+        }
+        commit_hist.swap(squashed);
+        trimHistory();
+        commit_hist.shrink_to_fit();
+        for (auto& commit: commit_hist) {
+            commit->diffs.shrink_to_fit();
+        }
+        std::size_t after = historyBytes();
+        return before > after? before - after: 0;
+    }
+
+    std::size_t Expense::historyBytes() const {
+        std::size_t bytes = 0;
+        for (auto& commit: commit_hist) {
+            bytes += sizeof(commit) + sizeof(ExpenseCommit)
+                + commit->diffs.capacity() * sizeof(ExpenseCommit::singleDiff);
+            for (auto& diff: commit->diffs) {
+                //names short enough for the small string buffer have no allocation of their own
+                if (diff.first.capacity() >= sizeof(std::string))   bytes += diff.first.capacity() + 1;
+            }
+        }
+        return bytes;
+    }
+
+    void Expense::internParticipants(std::shared_ptr<NameTable> table) {
+        name_table = std::move(table);
+        refreshDerived();
+    }
+
+    void Expense::refreshDerived() {
+        //FNV-1a over the names and the weights, in name order
+        std::uint64_t hash = fnv_offset_basis;
+        auto mix = [&hash] (unsigned char byte) {
+            hash ^= byte;
+            hash *= fnv_prime;
+        };
+        for (auto& weight: weights) {
+            for (unsigned char c: weight.first) mix(c);
+            mix(0);
+            mix(weight.second & 0xff);
+            mix(weight.second >> 8);
+        }
+        split_signature = hash;
+
+        if (!name_table)    return;
+        interned_weights.clear();
+        for (auto& weight: weights) {
+            interned_weights.push_back(std::make_pair(name_table->intern(weight.first),
+                        weight.second));
+        }
+        std::sort(interned_weights.begin(), interned_weights.end());
     }
 
     void Expense::rollBack() {
@@ -238,7 +435,7 @@ namespace AccountBalancer {
             std::cout << "already in the initial commit" << std::endl;
         }
         else {
-            auto& commit_ptr = commit_hist.back();
+            auto commit_ptr = std::move(commit_hist.back());
             commit_hist.pop_back();
             rollBack(*commit_ptr);
         }
@@ -255,6 +452,7 @@ namespace AccountBalancer {
             }
             total_weight -= (after - before);
         }
+        refreshDerived();
     }
 
     std::vector<Utils::Debt> Expense::toDebts(bool isReverse) {
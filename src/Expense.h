@@ -4,6 +4,7 @@
 //amount, share people, share weights, notes etc
 //Created by Theodore Yang on 1/4/2017
 
+#include <cstdint>
 #include <stack>
 #include <map>
 #include <set>
@@ -13,14 +14,27 @@
 #include <memory>
 
 #include "utils.h"
+#include "LedgerArena.h"
 
 namespace AccountBalancer {
     //a single commit in the expense report, we can roll back at any time
     struct ExpenseCommit;
 
+    class NameTable;
+
+    class ExpenseBuilder;
+
     //the expense class
     class Expense { 
     public:
+        //the largest share weight of a participant
+        static constexpr int max_weight = 999;
+
+        //the weight map and the note live in the memory resource the expense is made with
+        using WeightMap = std::map<std::string, int, std::less<std::string>,
+              ResourceAllocator<std::pair<const std::string, int>>>;
+        using Note = std::basic_string<char, std::char_traits<char>, ResourceAllocator<char>>;
+
         //constructor
         explicit Expense(const std::string& _creditor,
                 double _amount = 0);
@@ -28,6 +42,17 @@ namespace AccountBalancer {
         Expense(const std::string& _creditor,
                 double _amount,
                 const std::string& _note);
+
+        //the weight map nodes and the note are allocated from the resource, e.g. the arena
+        //of the ledger, which has to outlive the expense
+        Expense(const std::string& _creditor,
+                double _amount,
+                MemoryResource* resource);
+
+        Expense(const std::string& _creditor,
+                double _amount,
+                const std::string& _note,
+                MemoryResource* resource);
         //dtor
         ~Expense();
 
@@ -39,38 +64,106 @@ namespace AccountBalancer {
         double getAmount() const;
         std::string getCreditor() const;
         std::string getNote() const;
-        const std::map<std::string, int>& getWeightsMap() const;
+        const std::string& getCurrency() const noexcept;
+        //days since 1970-01-01, see Utils::parseDate
+        int getDate() const noexcept;
+        const WeightMap& getWeightsMap() const;
+
+        //a hash of the [participant, weight] pairs kept up to date on every change,
+        //expenses split the same way have the same signature, the converse is only likely
+        std::uint64_t getSplitSignature() const noexcept;
+
+        //O(log n) membership by interned ID, false if the participants are not interned
+        bool hasParticipant(int id) const;
+        //[participant ID, weight] of the participants of this expense sorted by ID, so the
+        //memory only grows with the participants of this expense and not with the largest
+        //ID of the name table, empty if not interned
+        const std::vector<std::pair<int, int>>& getInternedWeights() const noexcept;
 
         void printCommitsHistory(bool verbose = true) const;
         void printExpenseSummary() const;
 
         //modifiers
-        void setNote(std::string) noexcept;
+        void setNote(const std::string&);
         void setAmount(double) noexcept;
+        void setCurrency(std::string) noexcept;
+        void setDate(int) noexcept;
         void addParticipant(const std::vector<std::string>&);
         void removeParticipant(const std::vector<std::string>&);
         void changeWeights(const std::vector<std::pair<std::string, int>>&);
 
+        //intern the participants into the table and keep the interned weights next to
+        //the weight map, they are kept up to date on every change
+        void internParticipants(std::shared_ptr<NameTable> table);
+
         void rollBack();
         void rollBack(const ExpenseCommit& commit);
 
+        //record every change so that it can be rolled back, on by default,
+        //expenses made by an ExpenseBuilder do not keep any history
+        void setHistoryEnabled(bool enabled) noexcept;
+        bool isHistoryEnabled() const noexcept;
+
+        //keep at most max_depth commits (0 means no limit), older ones are folded into a
+        //checkpoint of the weights and can no longer be rolled back, with squash on a commit
+        //on the same participants as the last one is merged into it as a single net diff
+        void setHistoryPolicy(std::size_t max_depth, bool squash);
+
+        //squash the whole history and drop the commits beyond the depth now
+        //return the bytes reclaimed
+        std::size_t compactHistory();
+
+        //approximate memory held by the commit history in bytes
+        std::size_t historyBytes() const;
+
         //to debts
         std::vector<Utils::Debt> toDebts(bool isReverse = false);
 
     private:
         bool verbose = false;
+        bool keep_history = true;
         //creditor
         std::string creditor;
         //total amount, always nonegative
         double amount;
         //a notation
-        std::string note;
-        //commit history
-        std::deque<std::unique_ptr<ExpenseCommit>> commit_hist;
+        Note note;
+        //currency code of the amount, empty means the base currency of the ledger
+        std::string currency;
+        //the day this expense happened, default to the day it is created
+        int date;
+        //commit history, a vector takes no memory until the first commit
+        std::vector<std::unique_ptr<ExpenseCommit>> commit_hist;
+        //history policy, see setHistoryPolicy
+        std::size_t max_history = 0;
+        bool squash_history = false;
+        //the weights before the oldest commit kept, once commits have been dropped
+        bool has_checkpoint = false;
+        WeightMap checkpoint;
         //the current weight split
-        std::map<std::string, int> weights;
+        WeightMap weights;
         //total weight
         int total_weight;
+        //see getSplitSignature
+        std::uint64_t split_signature;
+        //the interned participants, see internParticipants
+        std::shared_ptr<NameTable> name_table;
+        std::vector<std::pair<int, int>> interned_weights;
+
+        //rebuild what is derived from the weight map: the split signature, and the
+        //interned weights once the participants are interned
+        void refreshDerived();
+
+        //push the commit onto the history if history is enabled
+        void recordCommit(std::unique_ptr<ExpenseCommit> commit);
+
+        //merge the newer commit into the older one if they are on the same participants
+        static bool squashCommits(ExpenseCommit& older, const ExpenseCommit& newer);
+
+        //fold the oldest commits into the checkpoint until the depth limit is met
+        void trimHistory();
+
+        friend class ExpenseBuilder;
 
         //format the weight information so that we can facillitate printing
         std::vector<std::string> formatWeightsString() const;
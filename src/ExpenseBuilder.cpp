@@ -0,0 +1,67 @@
+//implement the expense builder
+#include "ExpenseBuilder.h"
+
+namespace AccountBalancer {
+    ExpenseBuilder::ExpenseBuilder(const std::string& _creditor, double _amount):
+        creditor(_creditor),
+        amount(_amount),
+        date(Utils::today()) {}
+
+    void ExpenseBuilder::setNote(std::string _note) {
+        note = std::move(_note);
+    }
+
+    void ExpenseBuilder::setCurrency(std::string _currency) {
+        currency = std::move(_currency);
+    }
+
+    void ExpenseBuilder::setDate(int _date) noexcept {
+        date = _date;
+    }
+
+    void ExpenseBuilder::setWeights(std::vector<std::pair<std::string, int>> _weights) {
+        weights = std::move(_weights);
+    }
+
+    void ExpenseBuilder::setArena(LedgerArena* _arena) noexcept {
+        arena = _arena;
+    }
+
+    std::shared_ptr<Expense> ExpenseBuilder::build() const {
+        if (weights.empty()) {
+            std::cerr << "at least one participant has to show up" << std::endl;
+            return nullptr;
+        }
+        for (std::size_t pos = 0; pos < weights.size(); ++pos) {
+            if (pos && !(weights[pos - 1].first < weights[pos].first)) {
+                std::cerr << "participants are not sorted or duplicated at " << weights[pos].first << std::endl;
+                return nullptr;
+            }
+            if (weights[pos].second <= 0 || weights[pos].second > Expense::max_weight) {
+                std::cerr << weights[pos].first << "'s share weight is out of range" << std::endl;
+                return nullptr;
+            }
+        }
+        //the expense and its control block in a single allocation
+        std::shared_ptr<Expense> expense;
+        if (arena) {
+            ResourceAllocator<Expense> allocator(arena);
+            expense = note.empty()? std::allocate_shared<Expense>(allocator, creditor, amount, arena):
+                std::allocate_shared<Expense>(allocator, creditor, amount, note, arena);
+        }
+        else {
+            expense = note.empty()? std::make_shared<Expense>(creditor, amount):
+                std::make_shared<Expense>(creditor, amount, note);
+        }
+        expense->keep_history = false;
+        expense->currency = currency;
+        expense->date = date;
+        //sorted input, every insert goes right before the end in constant time
+        for (auto& weight: weights) {
+            expense->weights.emplace_hint(expense->weights.end(), weight.first, weight.second);
+            expense->total_weight += weight.second;
+        }
+        expense->refreshDerived();
+        return expense;
+    }
+} //AccountBalancer
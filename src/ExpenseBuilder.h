@@ -0,0 +1,45 @@
+//Build expenses in bulk, for importers and generators
+//the participants come in as a [name, weight] array sorted by name, so the weight map
+//is filled in a single pass with hinted inserts, and no commit history is recorded
+#ifndef __BALANCE_EXPENSE_BUILDER_H
+#define __BALANCE_EXPENSE_BUILDER_H
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Expense.h"
+
+namespace AccountBalancer {
+    class ExpenseBuilder {
+    public:
+        ExpenseBuilder(const std::string& _creditor, double _amount);
+
+        void setNote(std::string _note);
+        void setCurrency(std::string _currency);
+        //days since 1970-01-01, default to today
+        void setDate(int _date) noexcept;
+
+        //participants sorted by name without duplicates, weights in [1, Expense::max_weight]
+        void setWeights(std::vector<std::pair<std::string, int>> _weights);
+
+        //make the expenses in the arena of the ledger instead of the heap, the expense,
+        //its reference count, weight map and note then take no allocation of their own,
+        //the arena has to outlive every expense made in it, nullptr goes back to the heap
+        void setArena(LedgerArena* _arena) noexcept;
+
+        //make the expense, the builder can be reused afterwards
+        //return nullptr if the participants are empty, not sorted or a weight is out of range
+        std::shared_ptr<Expense> build() const;
+
+    private:
+        std::string creditor;
+        double amount;
+        std::string note;
+        std::string currency;
+        int date;
+        std::vector<std::pair<std::string, int>> weights;
+        LedgerArena* arena = nullptr;
+    };
+} //AccountBalancer
+#endif
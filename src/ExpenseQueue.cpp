@@ -0,0 +1,84 @@
+//implement the sharded expense queue
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <thread>
+
+#include "ExpenseQueue.h"
+
+namespace {
+    //every thread gets a ticket the first time it pushes, the shard is the ticket modulo
+    //the number of shards, so threads spread out evenly over the shards
+    std::atomic<unsigned> next_ticket(0);
+} //anonymous namespace
+
+namespace AccountBalancer {
+    ExpenseQueue::ExpenseQueue(unsigned shards):
+        num_shards(shards? shards: std::max(1u, std::thread::hardware_concurrency())),
+        shards(new Shard[num_shards]),
+        next_sequence(0),
+        num_drained(0) {}
+
+    ExpenseQueue::~ExpenseQueue() = default;
+
+    ExpenseQueue::Shard& ExpenseQueue::shardOfThisThread() {
+        thread_local unsigned ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+        return shards[ticket % num_shards];
+    }
+
+    void ExpenseQueue::push(std::shared_ptr<Expense> expense) {
+        Shard& shard = shardOfThisThread();
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            std::uint64_t sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+            shard.items.emplace_back(sequence, std::move(expense));
+        }
+    }
+
+    std::size_t ExpenseQueue::drain(std::vector<std::shared_ptr<Expense>>& out) {
+        std::vector<std::vector<std::pair<std::uint64_t, std::shared_ptr<Expense>>>> taken(num_shards);
+        //hold every lock at the same time, no producer is between taking a number and
+        //storing its expense then
+        for (unsigned pos = 0; pos < num_shards; ++pos) {
+            shards[pos].lock.lock();
+        }
+        std::size_t total = 0;
+        for (unsigned pos = 0; pos < num_shards; ++pos) {
+            taken[pos].swap(shards[pos].items);
+            total += taken[pos].size();
+        }
+        num_drained.fetch_add(total, std::memory_order_relaxed);
+        for (unsigned pos = num_shards; pos-- > 0; ) {
+            shards[pos].lock.unlock();
+        }
+
+        //every shard is already in push order, a k-way merge on the smallest head of the
+        //shards takes O(n log shards), a shard mostly holds runs of consecutive numbers
+        //(a single producer holds all of them), which are taken without the heap
+        using Head = std::pair<std::uint64_t, unsigned>;
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+        std::vector<std::size_t> next(num_shards, 0);
+        for (unsigned pos = 0; pos < num_shards; ++pos) {
+            if (!taken[pos].empty())    heads.push(Head(taken[pos].front().first, pos));
+        }
+        out.reserve(out.size() + total);
+        while (!heads.empty()) {
+            unsigned shard = heads.top().second;
+            heads.pop();
+            auto& items = taken[shard];
+            std::size_t& pos = next[shard];
+            do {
+                out.push_back(std::move(items[pos].second));
+                ++pos;
+            } while (pos < items.size() && (heads.empty() || items[pos].first < heads.top().first));
+            if (pos < items.size()) heads.push(Head(items[pos].first, shard));
+        }
+        return total;
+    }
+
+    std::size_t ExpenseQueue::size() const noexcept {
+        //drained first, it never gets ahead of the sequence numbers read after it
+        std::uint64_t drained = num_drained.load(std::memory_order_acquire);
+        return next_sequence.load(std::memory_order_acquire) - drained;
+    }
+} //AccountBalancer
@@ -0,0 +1,58 @@
+//Collect expenses committed by several threads at once
+//every producer thread sticks to one of a few shards, each behind its own lock, so producers
+//rarely wait on each other, draining locks all the shards at once and merges them back into
+//the order the expenses were pushed in
+#ifndef __BALANCE_EXPENSE_QUEUE_H
+#define __BALANCE_EXPENSE_QUEUE_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Expense.h"
+
+namespace AccountBalancer {
+    class ExpenseQueue {
+    public:
+        //0 means one shard per hardware thread
+        explicit ExpenseQueue(unsigned shards = 0);
+
+        ~ExpenseQueue();
+
+        ExpenseQueue(const ExpenseQueue&) = delete;
+        ExpenseQueue& operator=(const ExpenseQueue&) = delete;
+
+        //safe to call from any number of threads
+        void push(std::shared_ptr<Expense> expense);
+
+        //move every expense pushed so far to the back of out, in push order
+        //the result is a consistent snapshot: an expense is only left behind if it was
+        //pushed after every expense that is taken
+        //return the number of expenses taken
+        std::size_t drain(std::vector<std::shared_ptr<Expense>>& out);
+
+        //expenses waiting to be drained, only a hint while producers are running
+        std::size_t size() const noexcept;
+
+    private:
+        struct Shard {
+            std::mutex lock;
+            //[push sequence number, expense]
+            std::vector<std::pair<std::uint64_t, std::shared_ptr<Expense>>> items;
+            //keep two shards off the same cache line
+            char padding[64];
+        };
+
+        unsigned num_shards;
+        std::unique_ptr<Shard[]> shards;
+        //sequence numbers are taken under a shard lock, so every number below the counter
+        //is in a shard while drain holds all the locks
+        std::atomic<std::uint64_t> next_sequence;
+        //expenses taken by drain so far, written with every lock held
+        std::atomic<std::uint64_t> num_drained;
+
+        Shard& shardOfThisThread();
+    };
+} //AccountBalancer
+#endif
@@ -0,0 +1,89 @@
+//implement the memory resources
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "LedgerArena.h"
+
+namespace {
+    //blocks stop doubling at this size
+    constexpr std::size_t max_block_bytes = 1 << 24;
+
+    class HeapResource: public AccountBalancer::MemoryResource {
+    private:
+        void* doAllocate(std::size_t bytes, std::size_t) override {
+            return ::operator new(bytes);
+        }
+
+        void doDeallocate(void* ptr, std::size_t, std::size_t) override {
+            ::operator delete(ptr);
+        }
+    };
+} //anonymous namespace
+
+namespace AccountBalancer {
+    MemoryResource* MemoryResource::heap() noexcept {
+        static HeapResource resource;
+        return &resource;
+    }
+
+    LedgerArena::LedgerArena(std::size_t initial_bytes):
+        next_block(std::max<std::size_t>(initial_bytes, 64)),
+        current(nullptr),
+        left(0),
+        allocated(0),
+        reserved(0),
+        in_use(0) {}
+
+    LedgerArena::~LedgerArena() {
+        release();
+    }
+
+    void LedgerArena::release() noexcept {
+        assert(in_use == 0 && "objects made in the arena are still alive");
+        for (auto& block: blocks) {
+            ::operator delete(block.first);
+        }
+        blocks.clear();
+        current = nullptr;
+        left = allocated = reserved = in_use = 0;
+    }
+
+    void* LedgerArena::doAllocate(std::size_t bytes, std::size_t alignment) {
+        std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+        if (!current || padding + bytes > left) {
+            //a new block, large requests get a block of their own size
+            std::size_t size = std::max(next_block, bytes + alignment);
+            current = static_cast<char*>(::operator new(size));
+            blocks.push_back(std::make_pair(current, size));
+            left = size;
+            reserved += size;
+            next_block = std::min(2 * next_block, max_block_bytes);
+            padding = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+        }
+        void* res = current + padding;
+        current += padding + bytes;
+        left -= padding + bytes;
+        allocated += bytes;
+        in_use += bytes;
+        return res;
+    }
+
+    //memory only goes back when the whole arena is released, only the bytes in use are
+    //counted down
+    void LedgerArena::doDeallocate(void*, std::size_t bytes, std::size_t) {
+        in_use -= bytes;
+    }
+
+    std::size_t LedgerArena::bytesAllocated() const noexcept {
+        return allocated;
+    }
+
+    std::size_t LedgerArena::bytesReserved() const noexcept {
+        return reserved;
+    }
+
+    std::size_t LedgerArena::bytesInUse() const noexcept {
+        return in_use;
+    }
+} //AccountBalancer
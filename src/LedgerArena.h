@@ -0,0 +1,117 @@
+//Memory for a whole ledger in a few large blocks
+//MemoryResource and ResourceAllocator play the parts of std::pmr::memory_resource and
+//std::pmr::polymorphic_allocator (not available in C++14): containers take an allocator
+//that forwards to whatever resource it was given, the heap by default
+//a LedgerArena hands memory out of growing blocks and never frees single allocations,
+//everything goes back at once when the arena is released or destroyed
+//the arena is optional and only reached through ExpenseBuilder::setArena, for importers
+//and generators making many expenses at once, the ledger of Control keeps its expenses
+//and names on the heap
+#ifndef __BALANCE_LEDGER_ARENA_H
+#define __BALANCE_LEDGER_ARENA_H
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace AccountBalancer {
+    class MemoryResource {
+    public:
+        virtual ~MemoryResource() = default;
+
+        void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+            return doAllocate(bytes, alignment);
+        }
+
+        void deallocate(void* ptr, std::size_t bytes,
+                std::size_t alignment = alignof(std::max_align_t)) {
+            doDeallocate(ptr, bytes, alignment);
+        }
+
+        //operator new and operator delete
+        static MemoryResource* heap() noexcept;
+
+    private:
+        virtual void* doAllocate(std::size_t bytes, std::size_t alignment) = 0;
+        virtual void doDeallocate(void* ptr, std::size_t bytes, std::size_t alignment) = 0;
+    };
+
+    //not thread safe, build the expenses of an arena on a single thread
+    class LedgerArena: public MemoryResource {
+    public:
+        //the first block holds initial_bytes, every next one twice the last, up to a limit
+        explicit LedgerArena(std::size_t initial_bytes = 1 << 16);
+
+        ~LedgerArena();
+
+        LedgerArena(const LedgerArena&) = delete;
+        LedgerArena& operator=(const LedgerArena&) = delete;
+
+        //free every block at once, objects in the arena are not destroyed, so every object
+        //made in it has to be destroyed first, an Expense also owns heap memory (creditor,
+        //currency, commit history) that only its destructor gives back
+        //debug builds assert that every byte handed out has been deallocated
+        void release() noexcept;
+
+        //bytes handed out and bytes taken from the heap
+        std::size_t bytesAllocated() const noexcept;
+        std::size_t bytesReserved() const noexcept;
+
+        //bytes handed out and not deallocated yet, 0 once every object in the arena is gone
+        std::size_t bytesInUse() const noexcept;
+
+    private:
+        std::vector<std::pair<char*, std::size_t>> blocks;
+        std::size_t next_block;
+        //free space of the current block
+        char* current;
+        std::size_t left;
+        std::size_t allocated;
+        std::size_t reserved;
+        std::size_t in_use;
+
+        void* doAllocate(std::size_t bytes, std::size_t alignment) override;
+        void doDeallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    };
+
+    //an allocator forwarding to a memory resource, the resource has to outlive every
+    //container and object allocated through it
+    template <typename T>
+    class ResourceAllocator {
+    public:
+        using value_type = T;
+
+        ResourceAllocator() noexcept: resource(MemoryResource::heap()) {}
+
+        ResourceAllocator(MemoryResource* _resource) noexcept: resource(_resource) {}
+
+        template <typename U>
+        ResourceAllocator(const ResourceAllocator<U>& other) noexcept: resource(other.getResource()) {}
+
+        T* allocate(std::size_t count) {
+            return static_cast<T*>(resource->allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* ptr, std::size_t count) {
+            resource->deallocate(ptr, count * sizeof(T), alignof(T));
+        }
+
+        MemoryResource* getResource() const noexcept {
+            return resource;
+        }
+
+    private:
+        MemoryResource* resource;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs) noexcept {
+        return lhs.getResource() == rhs.getResource();
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs) noexcept {
+        return !(lhs == rhs);
+    }
+} //AccountBalancer
+#endif
@@ -0,0 +1,300 @@
+//implement the local search over zero-sum groups
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "LocalSearch.h"
+#include "DynamicBitset.h"
+
+namespace {
+    //temperature at the start and at the end of the time budget
+    constexpr double hot = 2.0;
+    constexpr double cold = 0.05;
+
+    //candidates tried when splitting the whole ledger at the start
+    constexpr std::size_t initial_probes = 1 << 22;
+
+    //members sampled and the largest amount in cents for carving a group
+    constexpr std::size_t carve_members = 48;
+    constexpr long long carve_cents = 1 << 20;
+
+    //members sampled for the meet in the middle search of a zero-sum subset, half a side
+    constexpr std::size_t split_members = 24;
+} //anonymous namespace
+
+namespace AccountBalancer {
+    LocalSearch::LocalSearch(const std::vector<long long>& _balances, unsigned seed):
+        balances(_balances),
+        rng(seed),
+        num_gaps(0) {
+        for (long long balance: balances) {
+            if (balance)    ++num_gaps;
+        }
+    }
+
+    void LocalSearch::splitGroup(std::vector<int>& group, std::size_t probes,
+            std::vector<std::vector<int>>& pieces) {
+        const int size = group.size();
+        std::shuffle(group.begin(), group.end(), rng);
+        std::unordered_map<long long, std::vector<int>> by_amount;
+        for (int pos = 0; pos < size; ++pos) {
+            by_amount[balances[group[pos]]].push_back(pos);
+        }
+        std::vector<char> taken(size, 0);
+        //a position of the given amount that is neither taken nor excluded, -1 if none
+        auto find = [&by_amount, &taken] (long long amount, int except1, int except2) -> int {
+            auto found = by_amount.find(amount);
+            if (found == by_amount.end())   return -1;
+            auto& bucket = found->second;
+            while (!bucket.empty() && taken[bucket.back()]) bucket.pop_back();
+            for (auto it = bucket.rbegin(); it != bucket.rend(); ++it) {
+                if (!taken[*it] && *it != except1 && *it != except2)    return *it;
+            }
+            return -1;
+        };
+        //pairs first, a pair never costs a transfer, then triples and quadruples
+        for (int first = 0; first < size; ++first) {
+            if (taken[first])   continue;
+            int second = find(-balances[group[first]], first, first);
+            if (second >= 0) {
+                taken[first] = taken[second] = 1;
+                pieces.push_back(std::vector<int>{group[first], group[second]});
+            }
+        }
+        for (int first = 0; first < size; ++first) {
+            if (taken[first])   continue;
+            long long amount = balances[group[first]];
+            for (int pos = first + 1; pos < size && probes; ++pos) {
+                if (taken[pos]) continue;
+                --probes;
+                int third = find(-(amount + balances[group[pos]]), first, pos);
+                if (third < 0)  continue;
+                taken[first] = taken[pos] = taken[third] = 1;
+                pieces.push_back(std::vector<int>{group[first], group[pos], group[third]});
+                break;
+            }
+        }
+        //through the sums of pairs seen so far
+        std::vector<int> open;
+        for (int pos = 0; pos < size; ++pos) {
+            if (!taken[pos])    open.push_back(pos);
+        }
+        std::unordered_map<long long, std::pair<int, int>> pair_sums;
+        for (std::size_t i = 0; i < open.size(); ++i) {
+            for (std::size_t j = i + 1; j < open.size() && probes && !taken[open[i]]; ++j) {
+                int first = open[i], second = open[j];
+                if (taken[second])  continue;
+                --probes;
+                long long sum = balances[group[first]] + balances[group[second]];
+                auto found = pair_sums.find(-sum);
+                if (found != pair_sums.end()) {
+                    int third = found->second.first, fourth = found->second.second;
+                    if (!taken[third] && !taken[fourth] && third != first && third != second
+                            && fourth != first && fourth != second) {
+                        taken[first] = taken[second] = taken[third] = taken[fourth] = 1;
+                        pieces.push_back(std::vector<int>{group[first], group[second],
+                                group[third], group[fourth]});
+                        break;
+                    }
+                }
+                pair_sums[sum] = std::make_pair(first, second);
+            }
+        }
+        //the rest sums up to zero as well
+        std::vector<int> rest;
+        for (int pos = 0; pos < size; ++pos) {
+            if (!taken[pos])    rest.push_back(group[pos]);
+        }
+        if (!rest.empty())  pieces.push_back(std::move(rest));
+    }
+
+    bool LocalSearch::carveGroup(const std::vector<int>& group,
+            std::vector<std::vector<int>>& pieces) {
+        if (group.size() < 4)   return false;
+        int start = group[rng() % group.size()];
+        long long target = std::llabs(balances[start]);
+        if (target > carve_cents)   return false;
+        std::vector<int> sample;
+        for (int member: group) {
+            long long amount = balances[member];
+            if ((amount > 0) != (balances[start] > 0) && std::llabs(amount) <= target) {
+                sample.push_back(member);
+            }
+        }
+        std::shuffle(sample.begin(), sample.end(), rng);
+        if (sample.size() > carve_members)  sample.resize(carve_members);
+        //subset sum on a bitset of the reachable amounts, one shift-or per member,
+        //the bitset before each member is kept to walk back
+        DynamicBitset reach(target + 1);
+        reach.set(0);
+        std::vector<DynamicBitset> before;
+        for (std::size_t index = 0; index < sample.size() && !reach.test(target); ++index) {
+            before.push_back(reach);
+            reach.orShifted(reach, std::llabs(balances[sample[index]]));
+        }
+        if (!reach.test(target))    return false;
+        std::vector<int> carved(1, start);
+        long long rest = target;
+        for (std::size_t index = before.size(); rest && index-- > 0; ) {
+            if (!before[index].test(rest)) {
+                carved.push_back(sample[index]);
+                rest -= std::llabs(balances[sample[index]]);
+            }
+        }
+        if (carved.size() == group.size())  return false;
+        std::sort(carved.begin(), carved.end());
+        std::vector<int> others;
+        for (int member: group) {
+            if (!std::binary_search(carved.begin(), carved.end(), member)) others.push_back(member);
+        }
+        pieces.push_back(std::move(carved));
+        pieces.push_back(std::move(others));
+        return true;
+    }
+
+    bool LocalSearch::carveZeroSum(const std::vector<int>& group,
+            std::vector<std::vector<int>>& pieces) {
+        if (group.size() < 4)   return false;
+        std::vector<int> sample(group);
+        std::shuffle(sample.begin(), sample.end(), rng);
+        if (sample.size() > split_members)  sample.resize(split_members);
+        const bool whole = sample.size() == group.size();
+        const std::size_t half = sample.size() / 2;
+        const std::uint32_t left_full = (1u << half) - 1;
+        const std::uint32_t right_full = (1u << (sample.size() - half)) - 1;
+        //the sum of every subset of a side, built from the subset without its lowest member
+        auto sumsOf = [this, &sample] (std::size_t first, std::uint32_t full) {
+            std::vector<long long> sums(full + 1, 0);
+            for (std::uint32_t mask = 1; mask <= full; ++mask) {
+                int low = 0;
+                while (!((mask >> low) & 1))    ++low;
+                sums[mask] = sums[mask & (mask - 1)] + balances[sample[first + low]];
+            }
+            return sums;
+        };
+        std::vector<long long> left_sums = sumsOf(0, left_full);
+        std::vector<long long> right_sums = sumsOf(half, right_full);
+        //a sum keeps its first two subsets, one of them is neither empty nor the whole group
+        //when combined with any subset of the other side
+        std::unordered_map<long long, std::pair<std::uint32_t, std::uint32_t>> by_sum;
+        for (std::uint32_t mask = 0; mask <= left_full; ++mask) {
+            auto inserted = by_sum.emplace(left_sums[mask], std::make_pair(mask, mask));
+            auto& subsets = inserted.first->second;
+            if (!inserted.second && subsets.first == subsets.second)    subsets.second = mask;
+        }
+        for (std::uint32_t right = 0; right <= right_full; ++right) {
+            auto found = by_sum.find(-right_sums[right]);
+            if (found == by_sum.end())  continue;
+            for (std::uint32_t left: {found->second.first, found->second.second}) {
+                if (!left && !right)    continue;
+                if (whole && left == left_full && right == right_full)  continue;
+                std::vector<int> carved;
+                for (std::size_t pos = 0; pos < sample.size(); ++pos) {
+                    std::uint32_t mask = pos < half? left: right;
+                    if ((mask >> (pos < half? pos: pos - half)) & 1)    carved.push_back(sample[pos]);
+                }
+                std::sort(carved.begin(), carved.end());
+                std::vector<int> others;
+                for (int member: group) {
+                    if (!std::binary_search(carved.begin(), carved.end(), member)) others.push_back(member);
+                }
+                pieces.push_back(std::move(carved));
+                pieces.push_back(std::move(others));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void LocalSearch::run(std::chrono::milliseconds budget) {
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&start] () -> double {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+        const double limit = budget.count() / 1000.0;
+
+        std::vector<int> all;
+        for (int pos = 0; pos < static_cast<int>(balances.size()); ++pos) {
+            if (balances[pos])  all.push_back(pos);
+        }
+        groups.clear();
+        splitGroup(all, initial_probes, groups);
+        best_groups = groups;
+        trajectory.assign(1, std::make_pair(elapsed(), numOfTransfers()));
+
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<std::vector<int>> pieces;
+        double temperature = hot;
+        std::size_t largest = 0;
+        for (std::size_t move = 0; !groups.empty(); ++move) {
+            if (largest >= groups.size())   largest = 0;
+            if (move % 64 == 0) {
+                double now = elapsed();
+                if (now >= limit)   break;
+                temperature = hot * std::pow(cold / hot, now / limit);
+                for (std::size_t index = 0; index < groups.size(); ++index) {
+                    if (groups[index].size() > groups[largest].size())  largest = index;
+                }
+                //no group can be carved any more and every pair was split off at the start,
+                //so merging two triples never gives three groups, nothing can do better
+                if (groups[largest].size() < 4) break;
+            }
+
+            //every other move tries to carve a group off the largest one, which always helps,
+            //a single group has nothing to merge with, so every move carves then
+            //the meet in the middle carve is only tried where the merges cannot help or
+            //where it covers the whole group
+            const bool single = groups.size() == 1;
+            pieces.clear();
+            if ((single || move % 2 == 0) && (carveGroup(groups[largest], pieces)
+                        || ((single || groups[largest].size() <= split_members)
+                            && carveZeroSum(groups[largest], pieces)))) {
+                groups[largest].swap(pieces.back());
+                groups.push_back(std::move(pieces.front()));
+            }
+            else if (single || !mergeSplit(temperature, uniform))   continue;
+            if (groups.size() > best_groups.size()) {
+                best_groups = groups;
+                trajectory.push_back(std::make_pair(elapsed(), numOfTransfers()));
+            }
+        }
+    }
+
+    bool LocalSearch::mergeSplit(double temperature,
+            std::uniform_real_distribution<double>& uniform) {
+        std::size_t a = rng() % groups.size(), b = rng() % (groups.size() - 1);
+        if (b >= a) ++b;
+        std::vector<int> merged(groups[a]);
+        merged.insert(merged.end(), groups[b].begin(), groups[b].end());
+        std::vector<std::vector<int>> pieces;
+        splitGroup(merged, 64 * merged.size(), pieces);
+        //the change in the number of groups, which is minus the change in transfers
+        int delta = static_cast<int>(pieces.size()) - 2;
+        if (delta < 0 && uniform(rng) >= std::exp(delta / temperature))   return false;
+
+        //replace both groups by the pieces, the higher index goes first
+        if (a < b)  std::swap(a, b);
+        groups[a].swap(groups.back());
+        groups.pop_back();
+        groups[b].swap(groups.back());
+        groups.pop_back();
+        for (auto& piece: pieces) {
+            groups.push_back(std::move(piece));
+        }
+        return true;
+    }
+
+    int LocalSearch::numOfTransfers() const noexcept {
+        return num_gaps - static_cast<int>(best_groups.size());
+    }
+
+    const std::vector<std::vector<int>>& LocalSearch::getGroups() const noexcept {
+        return best_groups;
+    }
+
+    const std::vector<std::pair<double, int>>& LocalSearch::getTrajectory() const noexcept {
+        return trajectory;
+    }
+} //AccountBalancer
@@ -0,0 +1,64 @@
+//A local search for the least number of transfers on large ledgers
+//a plan is a partition of the gaps into zero-sum groups, each group of size k settles
+//with k - 1 transfers, so more groups means less transfers
+//the search starts by splitting small zero-sum groups off the whole ledger, then keeps
+//carving groups off the largest group (even when that is the whole ledger), and merging two groups and splitting the result
+//again (simulated annealing, a move that loses a group is taken with a probability that
+//drops over time) until the time runs out
+#ifndef __BALANCE_LOCAL_SEARCH_H
+#define __BALANCE_LOCAL_SEARCH_H
+#include <chrono>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace AccountBalancer {
+    class LocalSearch {
+    public:
+        //balances in cents, positive means being owed, they must sum up to zero
+        //the search is random but seeded, the same seed and number of moves give the same plan
+        explicit LocalSearch(const std::vector<long long>& balances, unsigned seed = 20170105);
+
+        //improve the partition until the time budget runs out or it cannot get any better,
+        //which is once every group has less than four members
+        void run(std::chrono::milliseconds budget);
+
+        //transfers needed by the best partition found
+        int numOfTransfers() const noexcept;
+
+        //zero-sum groups of the best partition found, as indices into the balances
+        const std::vector<std::vector<int>>& getGroups() const noexcept;
+
+        //[seconds into the run, transfers] every time the best partition improved,
+        //the first entry is the starting partition
+        const std::vector<std::pair<double, int>>& getTrajectory() const noexcept;
+
+    private:
+        std::vector<long long> balances;
+        std::mt19937 rng;
+        //number of non-zero balances
+        int num_gaps;
+        std::vector<std::vector<int>> groups;
+        std::vector<std::vector<int>> best_groups;
+        std::vector<std::pair<double, int>> trajectory;
+
+        //split zero-sum pairs, triples and quadruples off a zero-sum group, picked in random
+        //order, what is left forms one more piece, probes bounds the candidates tried
+        void splitGroup(std::vector<int>& group, std::size_t probes,
+                std::vector<std::vector<int>>& pieces);
+
+        //split a group into a member and a subset of the other side summing up to it
+        //(subset sum over a sample of the members) and the rest, false if none is found
+        bool carveGroup(const std::vector<int>& group, std::vector<std::vector<int>>& pieces);
+
+        //split a group into any zero-sum subset of a sample of its members and the rest,
+        //meet in the middle over the subsets of the two halves of the sample, the sample is
+        //the whole group for small groups, false if none is found
+        bool carveZeroSum(const std::vector<int>& group, std::vector<std::vector<int>>& pieces);
+
+        //merge two random groups and split them again, a move that loses a group is
+        //taken with probability exp(-1 / temperature), return whether the move is taken
+        bool mergeSplit(double temperature, std::uniform_real_distribution<double>& uniform);
+    };
+} //AccountBalancer
+#endif
@@ -0,0 +1,125 @@
+//implement the min-cost max-flow engine
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "MinCostFlow.h"
+
+namespace {
+    constexpr long long infinity = std::numeric_limits<long long>::max() / 4;
+} //anonymous namespace
+
+namespace AccountBalancer {
+    MinCostFlow::MinCostFlow(int num_nodes): graph(num_nodes) {}
+
+    int MinCostFlow::addEdge(int from, int to, long long capacity, long long cost) {
+        int id = edges.size();
+        edges.push_back(Edge{to, capacity, cost, 0});
+        graph[from].push_back(id);
+        edges.push_back(Edge{from, 0, -cost, 0});
+        graph[to].push_back(id + 1);
+        return id;
+    }
+
+    std::pair<long long, long long> MinCostFlow::solve(int source, int sink) {
+        const int n = graph.size();
+        long long total_flow = 0, total_cost = 0;
+        //all the costs are non-negative at the beginning, so zero is a valid potential
+        std::vector<long long> potential(n, 0);
+        std::vector<long long> dist(n);
+        std::vector<int> level(n);
+        std::vector<std::size_t> next_arc(n);
+        using QueueEntry = std::pair<long long, int>;
+
+        auto residual = [this] (int id) -> long long {
+            return edges[id].capacity - edges[id].flow;
+        };
+        auto reducedCost = [this, &potential] (int from, int id) -> long long {
+            return edges[id].cost + potential[from] - potential[edges[id].to];
+        };
+
+        //push flow along admissible edges (zero reduced cost, going one level deeper)
+        std::function<long long(int, long long)> augment = [&] (int node, long long limit) -> long long {
+            if (node == sink)   return limit;
+            for (std::size_t& arc = next_arc[node]; arc < graph[node].size(); ++arc) {
+                int id = graph[node][arc];
+                int to = edges[id].to;
+                if (residual(id) <= 0 || level[to] != level[node] + 1 || reducedCost(node, id) != 0)
+                    continue;
+                long long pushed = augment(to, std::min(limit, residual(id)));
+                if (pushed > 0) {
+                    edges[id].flow += pushed;
+                    edges[id ^ 1].flow -= pushed;
+                    total_cost += pushed * edges[id].cost;
+                    return pushed;
+                }
+            }
+            return 0;
+        };
+
+        while (true) {
+            //shortest path on reduced costs, stop as soon as the sink is settled
+            std::fill(dist.begin(), dist.end(), infinity);
+            std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> heap;
+            dist[source] = 0;
+            heap.push(std::make_pair(0LL, source));
+            while (!heap.empty()) {
+                auto top = heap.top();
+                heap.pop();
+                int node = top.second;
+                if (top.first > dist[node]) continue;
+                if (node == sink)   break;
+                for (int id: graph[node]) {
+                    if (residual(id) <= 0)  continue;
+                    int to = edges[id].to;
+                    long long candidate = dist[node] + reducedCost(node, id);
+                    if (candidate < dist[to]) {
+                        dist[to] = candidate;
+                        heap.push(std::make_pair(candidate, to));
+                    }
+                }
+            }
+            //no augmenting path left, the flow is maximum
+            if (dist[sink] == infinity) break;
+            //nodes beyond the sink are capped, this keeps every reduced cost non-negative
+            for (int node = 0; node < n; ++node) {
+                potential[node] += std::min(dist[node], dist[sink]);
+            }
+
+            //the shortest paths are exactly the paths of zero reduced cost,
+            //saturate all of them at once with a blocking flow before searching again
+            while (true) {
+                std::fill(level.begin(), level.end(), -1);
+                std::queue<int> bfs;
+                level[source] = 0;
+                bfs.push(source);
+                while (!bfs.empty()) {
+                    int node = bfs.front();
+                    bfs.pop();
+                    for (int id: graph[node]) {
+                        int to = edges[id].to;
+                        if (level[to] < 0 && residual(id) > 0 && reducedCost(node, id) == 0) {
+                            level[to] = level[node] + 1;
+                            bfs.push(to);
+                        }
+                    }
+                }
+                if (level[sink] < 0)    break;
+                std::fill(next_arc.begin(), next_arc.end(), 0);
+                while (long long pushed = augment(source, infinity)) {
+                    total_flow += pushed;
+                }
+            }
+        }
+        return std::make_pair(total_flow, total_cost);
+    }
+
+    long long MinCostFlow::getFlow(int edge_id) const {
+        return edges[edge_id].flow;
+    }
+
+    int MinCostFlow::numOfNodes() const noexcept {
+        return graph.size();
+    }
+} //AccountBalancer
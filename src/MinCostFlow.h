@@ -0,0 +1,39 @@
+//A min-cost max-flow engine on integer capacities and costs
+//successive shortest paths, with Johnson potentials so that every
+//shortest path search is a Dijkstra on non-negative reduced costs
+#ifndef __BALANCE_MIN_COST_FLOW_H
+#define __BALANCE_MIN_COST_FLOW_H
+#include <utility>
+#include <vector>
+
+namespace AccountBalancer {
+    class MinCostFlow {
+    public:
+        explicit MinCostFlow(int num_nodes);
+
+        //add a directed edge, costs must be non-negative
+        //return the edge id, which can be used to query the flow later
+        int addEdge(int from, int to, long long capacity, long long cost);
+
+        //push as much flow as possible from source to sink with the minimum cost
+        //return [total flow, total cost]
+        std::pair<long long, long long> solve(int source, int sink);
+
+        //the flow that goes through the given edge after solve
+        long long getFlow(int edge_id) const;
+
+        int numOfNodes() const noexcept;
+
+    private:
+        struct Edge {
+            int to;
+            long long capacity;
+            long long cost;
+            long long flow;
+        };
+        //edges are stored in pairs, the residual edge of edges[i] is edges[i ^ 1]
+        std::vector<Edge> edges;
+        std::vector<std::vector<int>> graph;
+    };
+} //AccountBalancer
+#endif
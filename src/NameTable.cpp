@@ -0,0 +1,26 @@
+//implement the name table
+#include "NameTable.h"
+
+namespace AccountBalancer {
+    int NameTable::intern(const std::string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        int id = names.size();
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+
+    int NameTable::find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end()? -1: it->second;
+    }
+
+    const std::string& NameTable::name(int id) const {
+        return names.at(id);
+    }
+
+    int NameTable::size() const noexcept {
+        return names.size();
+    }
+} //AccountBalancer
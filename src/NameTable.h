@@ -0,0 +1,27 @@
+//Intern participant names into dense integer IDs
+//so that per-participant data can live in flat arrays instead of string keyed maps
+#ifndef __BALANCE_NAME_TABLE_H
+#define __BALANCE_NAME_TABLE_H
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AccountBalancer {
+    class NameTable {
+    public:
+        //return the ID of the name, a new ID is assigned if the name was never seen
+        int intern(const std::string& name);
+
+        //return the ID of the name, -1 if the name is not interned
+        int find(const std::string& name) const;
+
+        const std::string& name(int id) const;
+
+        int size() const noexcept;
+
+    private:
+        std::vector<std::string> names;
+        std::unordered_map<std::string, int> ids;
+    };
+} //AccountBalancer
+#endif
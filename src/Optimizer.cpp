@@ -2,11 +2,46 @@
 //Created by Theodore Yang on 1/5/2017
 #include <chrono>
 #include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <unordered_map>
 
 #include "Optimizer.h"
 #include "Expense.h"
+#include "ResultCache.h"
+#include "MinCostFlow.h"
+#include "ParticipantIndex.h"
+#include "ExactSolver.h"
+#include "DynamicBitset.h"
+#include "WorkStealingPool.h"
+#include "LocalSearch.h"
 
 namespace {
+    //file a single participant's gap on the creditor or the debtor side
+    void addGap(const std::string& name, double gap,
+            std::vector<std::pair<std::string, double>>& creditor_gaps,
+            std::vector<std::pair<std::string, double>>& debtor_gaps) {
+        if (AccountBalancer::Utils::isGreater(gap, 0.0)) {
+            creditor_gaps.push_back(std::make_pair(name, gap));
+        }
+        else if (AccountBalancer::Utils::isLess(gap, 0.0)) {
+            debtor_gaps.push_back(std::make_pair(name, -gap));
+        }
+        //ignore person whose gap is 0, they do not need to make transfers
+    }
+
+    //sort the gaps, based on the gap value
+    void sortGaps(std::vector<std::pair<std::string, double>>& creditor_gaps,
+            std::vector<std::pair<std::string, double>>& debtor_gaps) {
+        auto comparator = [](const std::pair<std::string, double>& p1, 
+                const std::pair<std::string, double>& p2) -> bool {
+            return p1.second < p2.second;
+        };
+        std::sort(creditor_gaps.begin(), creditor_gaps.end(), comparator);
+        std::sort(debtor_gaps.begin(), debtor_gaps.end(), comparator);
+    }
+
     //helper method to calculate the gaps
     //which is defined to be the absolute different of payment being made by a participant
     //and the amount he/she should spend
@@ -17,49 +52,215 @@ namespace {
         //process each participant
         for (auto it = personalExpenses.cbegin(), last = personalExpenses.cend();
                 it != last; ++it) {
-            auto name = it->first;
             double payment_made = it->second.getPaymentMadeValue();
             double total_expense = it->second.getTotalExpense();
-            double gap = payment_made - total_expense;
-            if (AccountBalancer::Utils::isGreater(gap, 0.0)) {
-                creditor_gaps.push_back(std::make_pair(name, gap));
-            }
-            else if (AccountBalancer::Utils::isLess(gap, 0.0)) {
-                debtor_gaps.push_back(std::make_pair(name, -gap));
+            addGap(it->first, payment_made - total_expense, creditor_gaps, debtor_gaps);
+        }
+        sortGaps(creditor_gaps, debtor_gaps);
+    }
+
+    //the same from net balances (payment made minus share of expenses)
+    void getBalanceGaps(const std::map<std::string, double>& balances,
+            std::vector<std::pair<std::string, double>>& creditor_gaps,
+            std::vector<std::pair<std::string, double>>& debtor_gaps) {
+        for (auto& balance: balances) {
+            addGap(balance.first, balance.second, creditor_gaps, debtor_gaps);
+        }
+        sortGaps(creditor_gaps, debtor_gaps);
+    }
+
+    //node budget of the branch and bound exact solvers
+    constexpr std::size_t exact_node_budget = 1 << 22;
+
+    //the gaps in cents by name, positive for creditors and negative for debtors
+    std::map<std::string, long long> gapCents(const AccountBalancer::GapList& creditor_gaps,
+            const AccountBalancer::GapList& debtor_gaps) {
+        std::map<std::string, long long> cents;
+        for (auto& gap: creditor_gaps) {
+            cents[gap.first] = std::llround(gap.second * 100.0);
+        }
+        for (auto& gap: debtor_gaps) {
+            cents[gap.first] = -std::llround(gap.second * 100.0);
+        }
+        return cents;
+    }
+
+    //convert the gaps into integer cents, positive for creditors and negative for debtors,
+    //gaps rounding to zero are dropped, and the rounding error is put on the largest gap
+    //so that the balances always sum up to zero
+    void toCents(const AccountBalancer::GapList& creditor_gaps,
+            const AccountBalancer::GapList& debtor_gaps,
+            std::vector<std::string>& names, std::vector<long long>& cents) {
+        long long sum = 0;
+        int largest = -1;
+        auto push = [&] (const std::string& name, long long value) {
+            if (!value) return;
+            if (largest < 0 || std::llabs(value) > std::llabs(cents[largest])) {
+                largest = cents.size();
             }
-            //ignore person whose gap is 0, they do not need to make transfers
+            names.push_back(name);
+            cents.push_back(value);
+            sum += value;
+        };
+        for (auto& gap: creditor_gaps) {
+            push(gap.first, std::llround(gap.second * 100.0));
         }
-        //sort the gaps, based on the gap value
-        auto comparator = [](const std::pair<std::string, double>& p1, 
-                const std::pair<std::string, double>& p2) -> bool {
-            return p1.second < p2.second;
+        for (auto& gap: debtor_gaps) {
+            push(gap.first, -std::llround(gap.second * 100.0));
+        }
+        if (largest >= 0)   cents[largest] -= sum;
+    }
+
+    template <std::size_t N>
+    bool runExactSolver(const std::vector<long long>& cents,
+            std::vector<AccountBalancer::Settlement>& plan,
+            const AccountBalancer::WorkStealingPool& pool) {
+        AccountBalancer::ExactSolver<N> solver(cents.data(), cents.size());
+        //the budget is the same for any number of threads, so is the plan found with it
+        bool proven = solver.solve(exact_node_budget, pool);
+        plan.assign(solver.begin(), solver.end());
+        return proven;
+    }
+
+    //settle every target with a member of the pool owing exactly the same amount,
+    //the pool is hashed by amount, return the number of pairs settled
+    template <typename Settle>
+    int matchPairs(const std::vector<int>& targets, const std::vector<int>& pool,
+            const std::vector<long long>& left, Settle settle) {
+        std::unordered_map<long long, std::vector<int>> by_amount;
+        for (int member: pool) {
+            if (left[member])   by_amount[left[member]].push_back(member);
+        }
+        int pairs = 0;
+        for (int target: targets) {
+            auto found = by_amount.find(left[target]);
+            if (found == by_amount.end() || found->second.empty())  continue;
+            int member = found->second.back();
+            found->second.pop_back();
+            settle(target, member, left[target]);
+            ++pairs;
+        }
+        return pairs;
+    }
+
+    //settle every target whose amount is the sum of two members of the pool (two-sum
+    //over the pool hashed by amount), return the number of targets settled
+    template <typename Settle>
+    int matchTwoSums(const std::vector<int>& targets, const std::vector<int>& pool,
+            const std::vector<long long>& left, Settle settle) {
+        std::unordered_map<long long, std::vector<int>> by_amount;
+        for (int member: pool) {
+            if (left[member])   by_amount[left[member]].push_back(member);
+        }
+        //a member of the given amount other than except, -1 if there is none
+        auto partner = [&by_amount, &left] (long long amount, int except) -> int {
+            auto found = by_amount.find(amount);
+            if (found == by_amount.end())   return -1;
+            auto& bucket = found->second;
+            //drop the members settled since
+            while (!bucket.empty() && left[bucket.back()] != amount) bucket.pop_back();
+            for (auto it = bucket.rbegin(); it != bucket.rend(); ++it) {
+                if (*it != except && left[*it] == amount)   return *it;
+            }
+            return -1;
         };
-        std::sort(creditor_gaps.begin(), creditor_gaps.end(), comparator);
-        std::sort(debtor_gaps.begin(), debtor_gaps.end(), comparator);
+        int matched = 0;
+        for (int target: targets) {
+            long long amount = left[target];
+            if (!amount)    continue;
+            for (int member: pool) {
+                long long first = left[member];
+                if (!first || first >= amount)  continue;
+                int second = partner(amount - first, member);
+                if (second < 0) continue;
+                settle(target, member, first);
+                settle(target, second, amount - first);
+                ++matched;
+                break;
+            }
+        }
+        return matched;
     }
 
-    bool findSubsetSum(double target, std::vector<std::pair<std::string, double>>& pool, 
-            int pos, long long& mask) {
-        //if the target is already 0, apparently the subset represent by mask is a valid answer
-        if (AccountBalancer::Utils::isEqual(target, 0.0)) return true;
+    //node budget of a single subset sum search on the generic path
+    constexpr std::size_t subset_node_budget = 1 << 16;
+
+    //find a subset of the pool summing up to target, the pool holds indices into left
+    //sorted by ascending amount, members whose amount left is zero are already used
+    bool findSubsetSum(long long target, const std::vector<int>& pool,
+            const std::vector<long long>& left, std::size_t pos,
+            AccountBalancer::DynamicBitset& chosen, std::size_t& budget) {
+        //if the target is already 0, apparently the chosen subset is a valid answer
+        if (target == 0)    return true;
+        if (pos >= pool.size() || budget == 0)  return false;
+        --budget;
+        long long value = left[pool[pos]];
         //since the pool is sorted, we can stop search faster
-        if (pos >= pool.size() || AccountBalancer::Utils::isGreater(pool[pos].second, target)) return false;
+        if (value > target) return false;
         //either we take pool[pos], or not
-        if (!AccountBalancer::Utils::isEqual(pool[pos].second, 0.0)) {
-            //search taking pool[pos]
-            double temp = pool[pos].second;
-            pool[pos].second = 0.0;
-            //flip mask value
-            mask |= (1 << pos);
-            if (findSubsetSum(target - temp, pool, pos + 1, mask)) {
+        if (value) {
+            chosen.set(pos);
+            if (findSubsetSum(target - value, pool, left, pos + 1, chosen, budget)) {
                 return true;
             }
             //back track
-            mask |= (1 << pos);
-            pool[pos].second = temp;
+            chosen.reset(pos);
+        }
+        return findSubsetSum(target, pool, left, pos + 1, chosen, budget);
+    }
+
+    //the subset sum dynamic programming is used when the total of the gaps in cents
+    //times the number of gaps is below this, it bounds the bits kept for reconstruction
+    constexpr long long subset_dp_threshold = 1LL << 27;
+
+    //same as findSubsetSum, but exact and pseudo-polynomial: reach holds every sum up to
+    //target made of the members seen so far, adding a member is a single shift-or,
+    //the bitset before each member is kept to walk back to the chosen members
+    bool findSubsetSumDP(long long target, const std::vector<int>& pool,
+            const std::vector<long long>& left, AccountBalancer::DynamicBitset& chosen) {
+        AccountBalancer::DynamicBitset reach(target + 1);
+        reach.set(0);
+        std::vector<std::size_t> members;
+        std::vector<AccountBalancer::DynamicBitset> before;
+        for (std::size_t pos = 0; pos < pool.size() && !reach.test(target); ++pos) {
+            long long value = left[pool[pos]];
+            if (!value) continue;
+            //since the pool is sorted, nothing after this fits either
+            if (value > target) break;
+            members.push_back(pos);
+            before.push_back(reach);
+            reach.orShifted(reach, value);
+        }
+        if (!reach.test(target))    return false;
+        //a sum missing before a member needs that member
+        long long rest = target;
+        for (std::size_t index = members.size(); rest && index-- > 0; ) {
+            if (!before[index].test(rest)) {
+                chosen.set(members[index]);
+                rest -= left[pool[members[index]]];
+            }
+        }
+        return true;
+    }
+
+    //settle every target whose amount equals the sum of a subset of the pool,
+    //one transfer per member of that subset, call settle(target, member, amount)
+    //use_dp picks findSubsetSumDP over the budgeted search
+    template <typename Settle>
+    void matchSubsets(const std::vector<int>& targets, const std::vector<int>& pool,
+            const std::vector<long long>& left, bool use_dp, Settle settle) {
+        AccountBalancer::DynamicBitset chosen(pool.size());
+        for (int target: targets) {
+            if (!left[target])  continue;
+            chosen.reset();
+            std::size_t budget = subset_node_budget;
+            bool found = use_dp? findSubsetSumDP(left[target], pool, left, chosen):
+                findSubsetSum(left[target], pool, left, 0, chosen, budget);
+            if (!found) continue;
+            for (std::size_t pos = chosen.findFirst(); pos < chosen.size(); pos = chosen.findNext(pos + 1)) {
+                settle(target, pool[pos], left[pool[pos]]);
+            }
         }
-        //search not taking pool[pos]
-        return findSubsetSum(target, pool, pos + 1, mask);
     }
 
     //transfer comparator, used to sort all the transfers
@@ -73,15 +274,121 @@ namespace {
     /*     return t2.amount != t1.amount? t2.amount < t1.amount: t1.other < t2.other; */
     /* }; */
 
-    void printTransfer(const AccountBalancer::Transfer& transfer) {
+    //printf into the end of a string
+    void appendf(std::string& out, const char* format, ...) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int size = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (size < 0)   return;
+        if (static_cast<std::size_t>(size) < sizeof(buffer)) {
+            out.append(buffer, size);
+            return;
+        }
+        //too long for the buffer, format again straight into the string
+        std::size_t old_size = out.size();
+        out.resize(old_size + size + 1);
+        va_start(args, format);
+        vsnprintf(&out[old_size], size + 1, format, args);
+        va_end(args);
+        out.resize(old_size + size);
+    }
+
+    void formatTransfer(const AccountBalancer::Transfer& transfer, std::string& out) {
         if (transfer.amount < 0) {
-            printf("Send       $%-8.2fto%20s\n", -transfer.amount, transfer.other.c_str());
+            appendf(out, "Send       $%-8.2fto%20s\n", -transfer.amount, transfer.other.c_str());
         }
         else if (transfer.amount > 0) {
-            printf("Receive    $%-8.2ffrom%18s\n", transfer.amount, transfer.other.c_str());
+            appendf(out, "Receive    $%-8.2ffrom%18s\n", transfer.amount, transfer.other.c_str());
+        }
+    }
+
+    //format a transfer whose amount is expressed in the given currency
+    void formatTransfer(const AccountBalancer::Transfer& transfer, double amount,
+            const std::string& currency, std::string& out) {
+        if (transfer.amount < 0) {
+            appendf(out, "Send       %-8.2f %-3s to%16s\n", amount, currency.c_str(), transfer.other.c_str());
+        }
+        else if (transfer.amount > 0) {
+            appendf(out, "Receive    %-8.2f %-3s from%14s\n", amount, currency.c_str(), transfer.other.c_str());
+        }
+    }
+
+    //what the report lines about an expense need, worked out once per expense for a report
+    //of everybody: the amount in the base currency, the total weight and the note
+    struct ExpenseFact {
+        double amount;
+        int weight_sum;
+        std::string note;
+    };
+    using ExpenseFacts = std::unordered_map<const AccountBalancer::Expense*, ExpenseFact>;
+
+    //names formatted by a worker at a time in the report of everybody
+    constexpr std::size_t report_block = 64;
+
+    //convert every expense amount into the base currency, the expenses are grouped by
+    //currency so each rate is looked up once, then a single multiplication pass over
+    //contiguous arrays does the conversion, return false if a currency has no rate
+    bool normalizeAmounts(const std::vector<std::shared_ptr<AccountBalancer::Expense>>& expenses,
+            const AccountBalancer::ExchangeRates& rates, std::vector<double>& amounts) {
+        const std::size_t n = expenses.size();
+        amounts.resize(n);
+        std::vector<double> factors(n, 1.0);
+        std::unordered_map<std::string, std::vector<std::size_t>> groups;
+        for (std::size_t pos = 0; pos < n; ++pos) {
+            amounts[pos] = expenses[pos]->getAmount();
+            const std::string& currency = expenses[pos]->getCurrency();
+            if (!currency.empty()) {
+                groups[currency].push_back(pos);
+            }
+        }
+        for (auto& group: groups) {
+            if (!rates.hasRate(group.first)) {
+                std::cerr << "no exchange rate for currency " << group.first << std::endl;
+                return false;
+            }
+            double rate = rates.getRate(group.first);
+            for (std::size_t pos: group.second) {
+                factors[pos] = rate;
+            }
+        }
+        for (std::size_t pos = 0; pos < n; ++pos) {
+            amounts[pos] *= factors[pos];
         }
+        return true;
     }
 
+    //[an expense, the total amount of every expense split the same way]
+    using SplitGroup = std::pair<const AccountBalancer::Expense*, double>;
+
+    //sum up the amounts (already normalized) of the expenses with the same participants
+    //and weights, so that every distinct split is divided among its participants only once,
+    //expenses are grouped by split signature and checked against the group's weight map
+    std::vector<SplitGroup> coalesceSplits(
+            const std::vector<std::shared_ptr<AccountBalancer::Expense>>& expenses,
+            const std::vector<double>& amounts) {
+        std::vector<SplitGroup> groups;
+        //split signature to the positions of its groups, more than one only on a collision
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>> by_signature;
+        for (std::size_t pos = 0; pos < expenses.size(); ++pos) {
+            const AccountBalancer::Expense& expense = *expenses[pos];
+            auto& candidates = by_signature[expense.getSplitSignature()];
+            bool found = false;
+            for (std::size_t group: candidates) {
+                if (groups[group].first->getWeightsMap() == expense.getWeightsMap()) {
+                    groups[group].second += amounts[pos];
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                candidates.push_back(groups.size());
+                groups.push_back(SplitGroup(&expense, amounts[pos]));
+            }
+        }
+        return groups;
+    }
 } //annoymous namespace
 
 namespace AccountBalancer {
@@ -91,103 +398,322 @@ namespace AccountBalancer {
     struct BalanceOptimizer::BalanceOptimizerImpl {
         bool verbose = false;
         //the time point with high resolution, which is kept at record
-        //to see if we need to update optimization
-        std::chrono::time_point<std::chrono::system_clock> last_optimize_time = 
-            std::chrono::system_clock::now();
+        //to see if we need to update optimization, the epoch until the first success
+        std::chrono::time_point<std::chrono::system_clock> last_optimize_time;
 
         //a map from name to tansferSummary, support orderer output
         std::map<std::string, TransferSummary> result;
-    };
 
-    //helper functions
-    OptimizerStatus BalanceOptimizer::leastTransferOptimize() {
-        //get the gaps for both creditors and debtors
-        //for definition of gaps, see function definition
-        std::vector<std::pair<std::string, double>> creditor_gaps;
-        std::vector<std::pair<std::string, double>> debtor_gaps;
-        getExpenseGaps(pimpl->result, creditor_gaps, debtor_gaps);
-        //least transfers require us to find whether there is a subset sum 
-        //from debtor_gaps to each gap values in creditor_gaps
-        //and vice versa, in this case, generate a bit mask to represent whether there is an 
-        //subset 
-        long long mask = 0;
-        for (int pos = 0; pos < creditor_gaps.size(); ++pos) {
-            if (findSubsetSum(creditor_gaps[pos].second, debtor_gaps, 0, mask)) {
-                //put the subset represented by mask into transfers
-                creditor_gaps[pos].second = 0.0;
-                const std::string creditor = creditor_gaps[pos].first;
-                for (int pos_debtor = 0; pos_debtor < debtor_gaps.size() && mask != 0; ++pos_debtor) {
-                    if ((1 << pos_debtor) & mask) {
-                        const std::string debtor = debtor_gaps[pos_debtor].first;
-                        double transfer_amount = debtor_gaps[pos_debtor].second;
-                        mask |= (1<< pos_debtor);
-                        pimpl->result.at(creditor).addTransfer(Transfer(debtor,
-                                    transfer_amount));
-                        pimpl->result.at(debtor).addTransfer(Transfer(creditor,
-                                    -transfer_amount));
+        //cache of previous optimization results, keyed by balance state
+        std::shared_ptr<ResultCache> cache = std::make_shared<ResultCache>();
+
+        //[payer, payee] pairs allowed in the constrained strategy
+        std::vector<std::pair<std::string, std::string>> allowed_transfers;
+
+        //exchange rates, all the gaps and transfers are in the base currency
+        ExchangeRates rates;
+        //name to the currency this person prefers to pay in
+        std::map<std::string, std::string> preferred_currency;
+
+        //inverted index of the ledger, if present the summaries do not keep expense lists
+        std::shared_ptr<const ParticipantIndex> index;
+
+        //threads of the exact least transfer search, 0 means all the hardware threads
+        unsigned num_threads = 0;
+
+        //time budget and the improvements of the local search
+        std::chrono::milliseconds time_budget{1000};
+        std::vector<std::pair<double, int>> trajectory;
+
+        //false when the last exact search ran out of nodes, its plan is then not cached
+        //since it might not be the least transfers
+        bool proven = true;
+
+        //warm start, the gaps in cents and the plan of the last successful run
+        bool warm_start = false;
+        bool has_last_run = false;
+        std::map<std::string, long long> last_gaps;
+        std::vector<Utils::Debt> last_plan;
+
+        //called on every successful optimizeExpenses
+        void rememberRun(std::map<std::string, long long> gaps) {
+            last_gaps = std::move(gaps);
+            last_plan = collectTransfers();
+            has_last_run = true;
+            last_optimize_time = std::chrono::system_clock::now();
+        }
+
+        //balances carried forward from closed epochs, positive means being owed
+        std::map<std::string, double> opening_balances;
+
+        //an export in progress streams the transfers to the sink, result stays empty,
+        //the net balance of everybody in the ledger is kept in balances instead
+        TransferSink sink;
+        std::map<std::string, double> balances;
+
+        //record a transfer from debtor to creditor on both sides
+        void recordTransfer(const std::string& creditor, const std::string& debtor, double amount) {
+            if (sink) {
+                sink(debtor, creditor, amount);
+                return;
+            }
+            result.at(creditor).addTransfer(Transfer(debtor, amount));
+            result.at(debtor).addTransfer(Transfer(creditor, -amount));
+        }
+
+        //the report sections of a participant, appended to out, facts may be nullptr,
+        //the expense amounts are converted on the fly then
+        OptimizerStatus formatTransfers(const std::string& name, std::string& out) const {
+            auto found = result.find(name);
+            if (found == result.end()) {
+                return OptimizerStatus::NAME_NOT_FOUND;
+            }
+            const TransferSummary& summary = found->second;
+            if (summary.getTransfers().empty()) {
+                out += "No Money Transfer Needed\n";
+            }
+            else {
+                out += "Suggested Transfers: \n";
+                for (const Transfer& transfer: summary.getTransfers()) {
+                    //the transfer is expressed in the currency of whoever pays it
+                    const std::string& payer = transfer.amount < 0? name: transfer.other;
+                    auto preferred = preferred_currency.find(payer);
+                    if (preferred != preferred_currency.end() && rates.hasRate(preferred->second)) {
+                        double amount = rates.fromBase(std::abs(transfer.amount), preferred->second);
+                        formatTransfer(transfer, amount, preferred->second, out);
                     }
+                    else {
+                        formatTransfer(transfer, out);
+                    }
+                }
+            }
+            return OptimizerStatus::SUCCESS;
+        }
+
+        OptimizerStatus formatExpenses(const std::string& name, const ExpenseFacts* facts,
+                std::string& out) const {
+            auto found = result.find(name);
+            if (found == result.end()) {
+                return OptimizerStatus::NAME_NOT_FOUND;
+            }
+            const TransferSummary& summary = found->second;
+            ExpenseFact scratch;
+            auto factOf = [facts, &scratch, this] (const Expense& expense) -> const ExpenseFact& {
+                if (facts)  return facts->at(&expense);
+                scratch = ExpenseFact{rates.toBase(expense.getAmount(), expense.getCurrency()),
+                    expense.getWeightSum(), expense.getNote()};
+                return scratch;
+            };
+            //[expense, share weight] and the expenses paid, from the index or the summary,
+            //someone with only a balance carried forward is in neither of them
+            std::vector<std::pair<std::shared_ptr<Expense>, int>> shares;
+            std::vector<std::shared_ptr<Expense>> paid;
+            if (index) {
+                for (auto& posting: index->getPostings(name)) {
+                    shares.push_back(std::make_pair(index->getExpense(posting.expense_id),
+                                posting.weight));
                 }
+                paid = index->paymentsOf(name);
             }
+            //the totals of the summary include the opening balance, as a payment when owed
+            //and as an expense when owing
+            auto opening = opening_balances.find(name);
+            double carried = opening == opening_balances.end()? 0.0: opening->second;
+
+            out += "Expense Breakdown \n";
+            if (index) {
+                for (auto& share: shares) {
+                    const ExpenseFact& fact = factOf(*share.first);
+                    double amount = fact.amount * static_cast<double>(share.second)
+                        / static_cast<double>(fact.weight_sum);
+                    appendf(out, "$%-8.2f%-30s(%d out of %d)\n", amount, fact.note.c_str(),
+                            share.second, fact.weight_sum);
+                }
+            }
+            else {
+                for (auto& expense_wptr: summary.getExpenses()) {
+                    if (expense_wptr.expired())  return OptimizerStatus::OUT_OF_TIME;
+                    auto expense_sptr = expense_wptr.lock();
+                    const ExpenseFact& fact = factOf(*expense_sptr);
+                    int share = expense_sptr->getWeight(name);
+                    double amount = fact.amount * static_cast<double>(share)
+                        / static_cast<double>(fact.weight_sum);
+                    appendf(out, "$%-8.2f%-30s(%d out of %d)\n", amount, fact.note.c_str(),
+                            share, fact.weight_sum);
+                }
+                for (auto& expense_wptr: summary.getPayments()) {
+                    paid.push_back(expense_wptr.lock());
+                }
+            }
+            if (carried < 0)    appendf(out, "$%-8.2f%-30s\n", -carried, "Carried forward");
+            appendf(out, "Total amount of expense:    $%-.2f\n", summary.getTotalExpense());
+            out += "\n";
+
+            if (!paid.empty() || carried > 0) {
+                out += "Expense paid by " + name + "\n";
+                for (auto& expense_sptr: paid) {
+                    const ExpenseFact& fact = factOf(*expense_sptr);
+                    appendf(out, "$%-8.2f%-15s\n", fact.amount, fact.note.c_str());
+                }
+                if (carried > 0)    appendf(out, "$%-8.2f%-15s\n", carried, "Carried forward");
+                appendf(out, "Total payment made:         $%-.2f\n", summary.getPaymentMadeValue());
+            }
+            else {
+                out += "No payment was made by " + name + "\n";
+            }
+            return OptimizerStatus::SUCCESS;
         }
-        for (int pos = 0; pos < debtor_gaps.size(); ++pos) {
-            if (!Utils::isEqual(debtor_gaps[pos].second, 0.0) &&
-                    findSubsetSum(debtor_gaps[pos].second, creditor_gaps, 0, mask)) {
-                debtor_gaps[pos].second = 0.0;
-                const std::string debtor = debtor_gaps[pos].first;
-                for (int pos_creditor = 0; pos_creditor < creditor_gaps.size() && mask != 0; ++pos_creditor) {
-                    if ((1 << pos_creditor) & mask) {
-                        mask |= (1 << pos_creditor);
-                        const std::string creditor = creditor_gaps[pos_creditor].first;
-                        double transfer_amount = creditor_gaps[pos_creditor].second;
-                        pimpl->result.at(creditor).addTransfer(Transfer(debtor, 
-                                    transfer_amount));
-                        pimpl->result.at(debtor).addTransfer(Transfer(creditor,
-                                    -transfer_amount));
+
+        OptimizerStatus formatSummary(const std::string& name, const ExpenseFacts* facts,
+                std::string& out) const {
+            if (result.find(name) == result.end()) {
+                return OptimizerStatus::NAME_NOT_FOUND;
+            }
+            out += std::string(60, '-') + "\n";
+            int padding = (60 - name.size()) / 2 - 4;
+            if (padding < 0)    padding = 0;
+            std::string leftPadding = std::string(padding, '-');
+            std::string rightPadding = name.size() % 2? std::string(padding + 1, '-'): leftPadding;
+            out += leftPadding + std::string(4, ' ') + name + std::string(4, ' ') + rightPadding + "\n";
+            out += "\n";
+            OptimizerStatus return_code = formatExpenses(name, facts, out);
+            if (return_code != OptimizerStatus::SUCCESS) {
+                return return_code;
+            }
+            out += "\n";
+            return_code = formatTransfers(name, out);
+            if (return_code != OptimizerStatus::SUCCESS)
+                return return_code;
+            out += "\n";
+            return OptimizerStatus::SUCCESS;
+        }
+
+        //collect the transfer plan from the result, one entry per transfer
+        std::vector<Utils::Debt> collectTransfers() const {
+            std::vector<Utils::Debt> transfers;
+            for (auto& entry: result) {
+                for (auto& transfer: entry.second.getTransfers()) {
+                    if (transfer.amount > 0) {
+                        transfers.push_back(Utils::Debt(entry.first, transfer.other, transfer.amount));
                     }
                 }
             }
+            return transfers;
         }
-        //now doing lazy matching
-        int pos_c = 0, pos_d = 0;
-        while (pos_c < creditor_gaps.size() && pos_d < debtor_gaps.size()) {
-            const std::string& creditor = creditor_gaps[pos_c].first;
-            double creditor_gap = creditor_gaps[pos_c].second;
+    };
 
-            const std::string& debtor = debtor_gaps[pos_d].first;
-            double debtor_gap = debtor_gaps[pos_d].second;
-            if (Utils::isEqual(creditor_gap, 0.0)) {
-                ++pos_c;
-                continue;
+    //helper functions
+    OptimizerStatus BalanceOptimizer::leastTransferOptimize(GapList& creditor_gaps,
+            GapList& debtor_gaps) {
+        //work on integer cents, left holds what is still open of every gap
+        std::vector<std::string> names;
+        std::vector<long long> left;
+        toCents(creditor_gaps, debtor_gaps, names, left);
+        std::vector<int> creditors, debtors;
+        for (int pos = 0; pos < static_cast<int>(left.size()); ++pos) {
+            if (left[pos] > 0)  creditors.push_back(pos);
+            else {
+                debtors.push_back(pos);
+                left[pos] = -left[pos];
             }
-            if (Utils::isEqual(debtor_gap, 0.0)) {
-                ++pos_d;
-                continue;
+        }
+        auto settle = [this, &names, &left] (int creditor, int debtor, long long amount) {
+            pimpl->recordTransfer(names[creditor], names[debtor], amount / 100.0);
+            left[creditor] -= amount;
+            left[debtor] -= amount;
+        };
+
+        //a creditor and a debtor with the same gap settle with each other in some optimal
+        //plan, so pairing them up first never costs a transfer
+        int pairs = matchPairs(creditors, debtors, left, settle);
+        std::vector<int> open;
+        std::vector<long long> cents;
+        for (int creditor: creditors) {
+            if (left[creditor]) {
+                open.push_back(creditor);
+                cents.push_back(left[creditor]);
             }
-            if (Utils::isGreater(creditor_gap, debtor_gap)) {
-                pimpl->result.at(creditor).addTransfer(Transfer(debtor, debtor_gap));
-                pimpl->result.at(debtor).addTransfer(Transfer(creditor, -debtor_gap));
-                creditor_gaps[pos_c].second -= debtor_gaps[pos_d++].second;
+        }
+        for (int debtor: debtors) {
+            if (left[debtor]) {
+                open.push_back(debtor);
+                cents.push_back(-left[debtor]);
             }
-            else if (Utils::isGreater(debtor_gap, creditor_gap)) {
-                pimpl->result.at(creditor).addTransfer(Transfer(debtor, creditor_gap));
-                pimpl->result.at(debtor).addTransfer(Transfer(creditor, -creditor_gap));
-                debtor_gaps[pos_d].second -= creditor_gaps[pos_c++].second;
+        }
+        if (pimpl->verbose) {
+            std::cerr << pairs << " exact pairs settled, " << open.size()
+                << " gaps left to search" << std::endl;
+        }
+
+        //when the gaps left fit in a machine word, use the compile-time specialized solvers
+        if (open.size() <= 64) {
+            std::vector<Settlement> plan;
+            bool proven;
+            WorkStealingPool pool(pimpl->num_threads);
+            if (cents.size() <= 8)  proven = runExactSolver<8>(cents, plan, pool);
+            else if (cents.size() <= 16)    proven = runExactSolver<16>(cents, plan, pool);
+            else if (cents.size() <= 32)    proven = runExactSolver<32>(cents, plan, pool);
+            else    proven = runExactSolver<64>(cents, plan, pool);
+            pimpl->proven = proven;
+            if (!proven && pimpl->verbose) {
+                std::cerr << "search budget ran out, the transfers might not be the least" << std::endl;
             }
-            else {
-                pimpl->result.at(creditor).addTransfer(Transfer(debtor, creditor_gap));
-                pimpl->result.at(debtor).addTransfer(Transfer(creditor, -debtor_gap));
+            for (auto& settlement: plan) {
+                settle(open[settlement.to], open[settlement.from], settlement.cents);
+            }
+            return OptimizerStatus::SUCCESS;
+        }
+
+        //the search is best effort from here on, so also settle a gap equal to the sum
+        //of two gaps on the other side with two transfers before going exponential
+        int triples = matchTwoSums(creditors, debtors, left, settle);
+        triples += matchTwoSums(debtors, creditors, left,
+                [&settle] (int debtor, int creditor, long long amount) {
+                    settle(creditor, debtor, amount);
+                });
+        if (pimpl->verbose) {
+            std::cerr << triples << " gaps settled by two transfers" << std::endl;
+        }
+
+        //least transfers require us to find whether there is a subset sum
+        //from debtors to each gap value of creditors and vice versa,
+        //the chosen subsets are kept in a bitset so any number of gaps works
+        auto ascending = [&left] (int pos1, int pos2) -> bool {
+            return left[pos1] < left[pos2];
+        };
+        std::sort(creditors.begin(), creditors.end(), ascending);
+        std::sort(debtors.begin(), debtors.end(), ascending);
+        //small amounts make the exact dynamic programming cheaper than the search
+        long long total_cents = 0;
+        for (int creditor: creditors) {
+            total_cents += left[creditor];
+        }
+        bool use_dp = total_cents <= subset_dp_threshold / static_cast<long long>(left.size());
+        matchSubsets(creditors, debtors, left, use_dp, settle);
+        matchSubsets(debtors, creditors, left, use_dp,
+                [&settle] (int debtor, int creditor, long long amount) {
+                    settle(creditor, debtor, amount);
+                });
+
+        //now doing lazy matching
+        std::size_t pos_c = 0, pos_d = 0;
+        while (pos_c < creditors.size() && pos_d < debtors.size()) {
+            int creditor = creditors[pos_c], debtor = debtors[pos_d];
+            if (!left[creditor]) {
                 ++pos_c;
+                continue;
+            }
+            if (!left[debtor]) {
                 ++pos_d;
+                continue;
             }
+            settle(creditor, debtor, std::min(left[creditor], left[debtor]));
         }
         return OptimizerStatus::SUCCESS;
     }
 
     //the lazy optimization, do not try to perfectly match participants expense
-    OptimizerStatus BalanceOptimizer::lazyOptimize() {
-        std::vector<std::pair<std::string, double>> creditor_gaps;
-        std::vector<std::pair<std::string, double>> debtor_gaps;
-        getExpenseGaps(pimpl->result, creditor_gaps, debtor_gaps);
+    OptimizerStatus BalanceOptimizer::lazyOptimize(GapList& creditor_gaps, GapList& debtor_gaps) {
         //since this is a lazy optimization, match each pair greedily
         int pos_c = 0, pos_d = 0;
         while (pos_c < creditor_gaps.size() && pos_d < debtor_gaps.size()) {
@@ -205,18 +731,15 @@ namespace AccountBalancer {
                 continue;
             }
             if (Utils::isGreater(creditor_gap, debtor_gap)) {
-                pimpl->result.at(creditor).addTransfer(Transfer(debtor, debtor_gap));
-                pimpl->result.at(debtor).addTransfer(Transfer(creditor, -debtor_gap));
+                pimpl->recordTransfer(creditor, debtor, debtor_gap);
                 creditor_gaps[pos_c].second -= debtor_gaps[pos_d++].second;
             }
             else if (Utils::isGreater(debtor_gap, creditor_gap)) {
-                pimpl->result.at(creditor).addTransfer(Transfer(debtor, creditor_gap));
-                pimpl->result.at(debtor).addTransfer(Transfer(creditor, -creditor_gap));
+                pimpl->recordTransfer(creditor, debtor, creditor_gap);
                 debtor_gaps[pos_d].second -= creditor_gaps[pos_c++].second;
             }
             else {
-                pimpl->result.at(creditor).addTransfer(Transfer(debtor, creditor_gap));
-                pimpl->result.at(debtor).addTransfer(Transfer(creditor, -debtor_gap));
+                pimpl->recordTransfer(creditor, debtor, creditor_gap);
                 ++pos_c;
                 ++pos_d;
             }
@@ -224,6 +747,104 @@ namespace AccountBalancer {
         return OptimizerStatus::SUCCESS;
     }
 
+    //the local search optimization, find a partition of the gaps into many zero-sum groups
+    //and settle every group greedily, which takes one transfer less than its size
+    OptimizerStatus BalanceOptimizer::localSearchOptimize(GapList& creditor_gaps,
+            GapList& debtor_gaps) {
+        std::vector<std::string> names;
+        std::vector<long long> cents;
+        toCents(creditor_gaps, debtor_gaps, names, cents);
+        LocalSearch search(cents);
+        search.run(pimpl->time_budget);
+        pimpl->trajectory = search.getTrajectory();
+        if (pimpl->verbose) {
+            for (auto& point: pimpl->trajectory) {
+                fprintf(stderr, "%8.3fs %8d transfers\n", point.first, point.second);
+            }
+        }
+        for (auto& group: search.getGroups()) {
+            std::vector<int> creditors, debtors;
+            for (int pos: group) {
+                if (cents[pos] > 0) creditors.push_back(pos);
+                else    debtors.push_back(pos);
+            }
+            std::size_t pos_c = 0, pos_d = 0;
+            while (pos_c < creditors.size() && pos_d < debtors.size()) {
+                int creditor = creditors[pos_c], debtor = debtors[pos_d];
+                long long amount = std::min(cents[creditor], -cents[debtor]);
+                pimpl->recordTransfer(names[creditor], names[debtor], amount / 100.0);
+                cents[creditor] -= amount;
+                cents[debtor] += amount;
+                if (!cents[creditor])   ++pos_c;
+                if (!cents[debtor]) ++pos_d;
+            }
+        }
+        return OptimizerStatus::SUCCESS;
+    }
+
+    //the constrained optimization, model the transfers as a min-cost flow where every
+    //allowed pair is an edge with unit cost per cent, so the minimum cost flow is the
+    //minimum amount of money moved, possibly relayed through other participants
+    OptimizerStatus BalanceOptimizer::constrainedOptimize(GapList& creditor_gaps,
+            GapList& debtor_gaps) {
+        //without any constraint every pair is allowed, and greedy matching already
+        //moves the minimum amount of money
+        if (pimpl->allowed_transfers.empty()) {
+            return lazyOptimize(creditor_gaps, debtor_gaps);
+        }
+        //everybody in the ledger is a node, even those with no gap can relay money
+        std::vector<std::string> names;
+        std::map<std::string, int> node_of;
+        auto addNode = [&names, &node_of] (const std::string& name) {
+            node_of[name] = names.size();
+            names.push_back(name);
+        };
+        if (pimpl->sink) {
+            for (auto& entry: pimpl->balances) {
+                addNode(entry.first);
+            }
+        }
+        else {
+            for (auto& entry: pimpl->result) {
+                addNode(entry.first);
+            }
+        }
+        const int source = names.size(), sink = names.size() + 1;
+        MinCostFlow flow(names.size() + 2);
+        long long total_debt = 0, total_credit = 0;
+        for (auto& gap: debtor_gaps) {
+            long long cents = std::llround(gap.second * 100.0);
+            flow.addEdge(source, node_of.at(gap.first), cents, 0);
+            total_debt += cents;
+        }
+        for (auto& gap: creditor_gaps) {
+            long long cents = std::llround(gap.second * 100.0);
+            flow.addEdge(node_of.at(gap.first), sink, cents, 0);
+            total_credit += cents;
+        }
+        //the allowed edges are not limited, the total debt is enough
+        //[edge id, [payer, payee]]
+        std::vector<std::pair<int, std::pair<int, int>>> edges;
+        for (auto& pair: pimpl->allowed_transfers) {
+            auto payer = node_of.find(pair.first), payee = node_of.find(pair.second);
+            if (payer == node_of.end() || payee == node_of.end() || payer == payee) continue;
+            int id = flow.addEdge(payer->second, payee->second, total_debt, 1);
+            edges.push_back(std::make_pair(id, std::make_pair(payer->second, payee->second)));
+        }
+        auto flow_cost = flow.solve(source, sink);
+        if (flow_cost.first < std::min(total_debt, total_credit)) {
+            std::cerr << "the allowed transfers can not settle all the balances" << std::endl;
+            return OptimizerStatus::FAILED;
+        }
+        for (auto& edge: edges) {
+            long long cents = flow.getFlow(edge.first);
+            if (cents <= 0) continue;
+            pimpl->recordTransfer(names[edge.second.second], names[edge.second.first],
+                    cents / 100.0);
+        }
+        return OptimizerStatus::SUCCESS;
+    }
+
     BalanceOptimizer::BalanceOptimizer(): pimpl(std::make_unique<BalanceOptimizerImpl>()) {}
 
     BalanceOptimizer::~BalanceOptimizer() = default;
@@ -237,25 +858,24 @@ namespace AccountBalancer {
             const std::vector<std::shared_ptr<Expense>>& expenses,
             OptimizerStrategy strategy) {
         pimpl->result.clear();
+        //normalize all the amounts into the base currency before aggregation
+        std::vector<double> amounts;
+        if (!normalizeAmounts(expenses, pimpl->rates, amounts)) {
+            return OptimizerStatus::FAILED;
+        }
         //process each expenses
-        for (auto& expense: expenses) {
-            auto weight_map = expense->getWeightsMap();
-            double amount = expense->getAmount();
-            double weight_sum = static_cast<double> (expense->getWeightSum());
-            for (auto it = weight_map.begin(), last = weight_map.end();
-                    it != last; ++it) {
-                std::string name = it->first;
-                int share = it->second;
-                
-                if (pimpl->result.find(name) == pimpl->result.end()) {
-                    pimpl->result.emplace(name, name);
+        for (std::size_t pos = 0; pos < expenses.size(); ++pos) {
+            auto& expense = expenses[pos];
+            double amount = amounts[pos];
+            //without an index every summary keeps its own expense list
+            if (!pimpl->index) {
+                for (auto& weight: expense->getWeightsMap()) {
+                    auto found = pimpl->result.find(weight.first);
+                    if (found == pimpl->result.end()) {
+                        found = pimpl->result.emplace(weight.first, weight.first).first;
+                    }
+                    found->second.addExpense(expense);
                 }
-                //this method might throw exception, but since we construct it before,
-                //it should be fine
-                pimpl->result.at(name).addExpense(expense);
-
-                //the expense need to add to everybody's account
-                pimpl->result.at(name).getTotalExpense() += amount * share / weight_sum;
             }
             //now the creditor of this expense has to be added into payment
             auto creditor = expense->getCreditor();
@@ -263,93 +883,366 @@ namespace AccountBalancer {
                 pimpl->result.emplace(creditor, creditor);
             }
             pimpl->result.at(creditor).getPaymentMadeValue() += amount;
-            pimpl->result.at(creditor).addPayment(expense);
+            if (!pimpl->index) {
+                pimpl->result.at(creditor).addPayment(expense);
+            }
+        }
+        //the expense need to add to everybody's account, once per distinct split
+        std::vector<SplitGroup> splits = coalesceSplits(expenses, amounts);
+        for (auto& split: splits) {
+            double weight_sum = static_cast<double> (split.first->getWeightSum());
+            for (auto& weight: split.first->getWeightsMap()) {
+                auto found = pimpl->result.find(weight.first);
+                if (found == pimpl->result.end()) {
+                    found = pimpl->result.emplace(weight.first, weight.first).first;
+                }
+                found->second.getTotalExpense() += split.second * weight.second / weight_sum;
+            }
+        }
+        if (pimpl->verbose) {
+            std::cerr << expenses.size() << " expenses in " << splits.size()
+                << " distinct splits" << std::endl;
+        }
+        //a balance carried forward counts as a payment made when being owed,
+        //and as an expense share otherwise
+        for (auto& opening: pimpl->opening_balances) {
+            auto found = pimpl->result.find(opening.first);
+            if (found == pimpl->result.end()) {
+                found = pimpl->result.emplace(opening.first, opening.first).first;
+            }
+            if (opening.second > 0) found->second.getPaymentMadeValue() += opening.second;
+            else    found->second.getTotalExpense() -= opening.second;
+        }
+        //get the gaps for both creditors and debtors
+        //for definition of gaps, see function definition
+        GapList creditor_gaps;
+        GapList debtor_gaps;
+        getExpenseGaps(pimpl->result, creditor_gaps, debtor_gaps);
+
+        //identical balance states always end up with the same transfers,
+        //except for the constrained strategy, whose plan also depends on the allowed pairs,
+        //and a warm start, whose plan also depends on the last plan, so it neither looks
+        //up nor inserts
+        bool use_cache = pimpl->cache && !(pimpl->warm_start && pimpl->has_last_run)
+            && strategy != OptimizerStrategy::CONSTRAINED;
+        ResultCache::Key key{};
+        if (use_cache) {
+            key = ResultCache::makeKey(creditor_gaps, debtor_gaps, strategy, pimpl->time_budget);
+            std::vector<Utils::Debt> transfers;
+            if (pimpl->cache->lookup(key, transfers)) {
+                for (auto& transfer: transfers) {
+                    pimpl->recordTransfer(transfer.creditor, transfer.debtor, transfer.amount);
+                }
+                pimpl->rememberRun(gapCents(creditor_gaps, debtor_gaps));
+                return OptimizerStatus::SUCCESS;
+            }
+        }
+
+        //repair the last plan instead of solving from scratch
+        if (pimpl->warm_start && pimpl->has_last_run) {
+            std::map<std::string, long long> gaps = gapCents(creditor_gaps, debtor_gaps);
+            OptimizerStatus status = warmStartOptimize(gaps, strategy);
+            if (status == OptimizerStatus::SUCCESS) {
+                pimpl->rememberRun(std::move(gaps));
+            }
+            return status;
+        }
+
+        OptimizerStatus status = runStrategy(strategy, creditor_gaps, debtor_gaps);
+        if (status == OptimizerStatus::SUCCESS && use_cache && pimpl->proven) {
+            pimpl->cache->insert(key, pimpl->collectTransfers());
+        }
+        if (status == OptimizerStatus::SUCCESS) {
+            pimpl->rememberRun(gapCents(creditor_gaps, debtor_gaps));
+        }
+        return status;
+    }
+
+    OptimizerStatus BalanceOptimizer::exportTransfers(
+            const std::vector<std::shared_ptr<Expense>>& expenses,
+            OptimizerStrategy strategy, const TransferSink& sink) {
+        std::vector<double> amounts;
+        if (!normalizeAmounts(expenses, pimpl->rates, amounts)) {
+            return OptimizerStatus::FAILED;
+        }
+        //a single net balance per person, no summary and no expense list is built
+        std::map<std::string, double>& balances = pimpl->balances;
+        balances.clear();
+        balances = pimpl->opening_balances;
+        for (std::size_t pos = 0; pos < expenses.size(); ++pos) {
+            balances[expenses[pos]->getCreditor()] += amounts[pos];
+        }
+        for (auto& split: coalesceSplits(expenses, amounts)) {
+            double weight_sum = static_cast<double> (split.first->getWeightSum());
+            for (auto& weight: split.first->getWeightsMap()) {
+                balances[weight.first] -= split.second * weight.second / weight_sum;
+            }
+        }
+        GapList creditor_gaps;
+        GapList debtor_gaps;
+        getBalanceGaps(balances, creditor_gaps, debtor_gaps);
+
+        OptimizerStatus status = runToSink(strategy, creditor_gaps, debtor_gaps, sink);
+        balances.clear();
+        return status;
+    }
+
+    OptimizerStatus BalanceOptimizer::simulateExpenses(
+            const std::vector<std::shared_ptr<Expense>>& expenses,
+            OptimizerStrategy strategy, std::vector<Utils::Debt>& transfers) {
+        std::vector<double> amounts;
+        if (!normalizeAmounts(expenses, pimpl->rates, amounts)) {
+            return OptimizerStatus::FAILED;
+        }
+        //the overlay, balance changes of the people the hypothetical expenses touch
+        std::unordered_map<std::string, double> delta;
+        for (std::size_t pos = 0; pos < expenses.size(); ++pos) {
+            auto& expense = expenses[pos];
+            //nobody to split it with, the overlay would not sum up to zero
+            if (!expense->getWeightSum()) {
+                std::cerr << "expense " << expense->getNote() << " has no share weight to split by"
+                    << std::endl;
+                return OptimizerStatus::FAILED;
+            }
+            double weight_sum = static_cast<double> (expense->getWeightSum());
+            delta[expense->getCreditor()] += amounts[pos];
+            for (auto& weight: expense->getWeightsMap()) {
+                delta[weight.first] -= amounts[pos] * weight.second / weight_sum;
+            }
+        }
+        //the balances of the last optimization with the overlay on top, read in place
+        const bool constrained = strategy == OptimizerStrategy::CONSTRAINED;
+        pimpl->balances.clear();
+        GapList creditor_gaps;
+        GapList debtor_gaps;
+        for (auto& entry: pimpl->result) {
+            double balance = entry.second.getPaymentMadeValue() - entry.second.getTotalExpense();
+            auto found = delta.find(entry.first);
+            if (found != delta.end()) {
+                balance += found->second;
+                delta.erase(found);
+            }
+            addGap(entry.first, balance, creditor_gaps, debtor_gaps);
+            //the constrained strategy relays through everybody in the ledger
+            if (constrained)    pimpl->balances.emplace(entry.first, balance);
+        }
+        //people who are not in the ledger yet
+        for (auto& entry: delta) {
+            addGap(entry.first, entry.second, creditor_gaps, debtor_gaps);
+            if (constrained)    pimpl->balances.emplace(entry.first, entry.second);
         }
+        sortGaps(creditor_gaps, debtor_gaps);
+
+        transfers.clear();
+        OptimizerStatus status = runToSink(strategy, creditor_gaps, debtor_gaps,
+                [&transfers] (const std::string& payer, const std::string& payee, double amount) {
+                    transfers.push_back(Utils::Debt(payee, payer, amount));
+                });
+        pimpl->balances.clear();
+        return status;
+    }
+
+    OptimizerStatus BalanceOptimizer::runToSink(OptimizerStrategy strategy,
+            GapList& creditor_gaps, GapList& debtor_gaps, const TransferSink& sink) {
+        //the cache, the warm start, the last result and its search trajectory are left untouched
+        auto trajectory = pimpl->trajectory;
+        pimpl->sink = sink;
+        OptimizerStatus status = runStrategy(strategy, creditor_gaps, debtor_gaps);
+        pimpl->sink = nullptr;
+        pimpl->trajectory.swap(trajectory);
+        return status;
+    }
+
+    OptimizerStatus BalanceOptimizer::runStrategy(OptimizerStrategy strategy,
+            GapList& creditor_gaps, GapList& debtor_gaps) {
+        OptimizerStatus status = OptimizerStatus::FAILED;
+        pimpl->proven = true;
         switch (strategy) {
             case OptimizerStrategy::LEAST_TRANSFER:
-                return leastTransferOptimize();
+                status = leastTransferOptimize(creditor_gaps, debtor_gaps);
+                break;
             case OptimizerStrategy::LAZY:
-                return lazyOptimize();
+                status = lazyOptimize(creditor_gaps, debtor_gaps);
+                break;
+            case OptimizerStrategy::CONSTRAINED:
+                status = constrainedOptimize(creditor_gaps, debtor_gaps);
+                break;
+            case OptimizerStrategy::LOCAL_SEARCH:
+                status = localSearchOptimize(creditor_gaps, debtor_gaps);
+                break;
         }
+        return status;
     }
 
-    OptimizerStatus BalanceOptimizer::printParticipantTransfers(const std::string& name) const {
-        if (pimpl->result.find(name) == pimpl->result.end()) {
-            return OptimizerStatus::NAME_NOT_FOUND;
-        }
-        const TransferSummary summary = pimpl->result.at(name);
-        if (summary.getTransfers().empty()) {
-            std::cout << "No Money Transfer Needed" << std::endl;
+    //keep the transfers of the last plan between participants whose gaps did not change,
+    //then solve what is left open with the strategy
+    OptimizerStatus BalanceOptimizer::warmStartOptimize(const std::map<std::string, long long>& gaps,
+            OptimizerStrategy strategy) {
+        auto gapOf = [] (const std::map<std::string, long long>& cents, const std::string& name) {
+            auto found = cents.find(name);
+            return found == cents.end()? 0LL: found->second;
+        };
+        auto unchanged = [&] (const std::string& name) -> bool {
+            return gapOf(gaps, name) == gapOf(pimpl->last_gaps, name);
+        };
+        std::map<std::string, long long> residual = gaps;
+        std::size_t kept = 0;
+        for (auto& transfer: pimpl->last_plan) {
+            if (!unchanged(transfer.creditor) || !unchanged(transfer.debtor))   continue;
+            long long amount = std::llround(transfer.amount * 100.0);
+            residual[transfer.creditor] -= amount;
+            residual[transfer.debtor] += amount;
+            pimpl->recordTransfer(transfer.creditor, transfer.debtor, transfer.amount);
+            ++kept;
         }
-        else {
-            std::cout << "Suggested Transfers: " << std::endl;
-            for (const Transfer& transfer: summary.getTransfers()) {
-                printTransfer(transfer);
+        GapList creditor_gaps, debtor_gaps;
+        for (auto& entry: residual) {
+            if (entry.second > 0) {
+                creditor_gaps.push_back(std::make_pair(entry.first, entry.second / 100.0));
+            }
+            else if (entry.second < 0) {
+                debtor_gaps.push_back(std::make_pair(entry.first, -entry.second / 100.0));
             }
         }
-        return OptimizerStatus::SUCCESS;
+        auto comparator = [] (const std::pair<std::string, double>& p1,
+                const std::pair<std::string, double>& p2) -> bool {
+            return p1.second < p2.second;
+        };
+        std::sort(creditor_gaps.begin(), creditor_gaps.end(), comparator);
+        std::sort(debtor_gaps.begin(), debtor_gaps.end(), comparator);
+        if (pimpl->verbose) {
+            std::cerr << kept << " transfers kept, " << creditor_gaps.size() + debtor_gaps.size()
+                << " participants solved again" << std::endl;
+        }
+        return runStrategy(strategy, creditor_gaps, debtor_gaps);
+    }
+
+    std::shared_ptr<ResultCache> BalanceOptimizer::getResultCache() const {
+        return pimpl->cache;
+    }
+
+    void BalanceOptimizer::setResultCache(std::shared_ptr<ResultCache> cache) {
+        pimpl->cache = std::move(cache);
+    }
+
+    void BalanceOptimizer::setAllowedTransfers(
+            const std::vector<std::pair<std::string, std::string>>& pairs) {
+        pimpl->allowed_transfers = pairs;
+    }
+
+    void BalanceOptimizer::setExchangeRates(const ExchangeRates& rates) {
+        pimpl->rates = rates;
+    }
+
+    void BalanceOptimizer::setPreferredCurrency(const std::string& name, const std::string& currency) {
+        pimpl->preferred_currency[name] = currency;
+    }
+
+    void BalanceOptimizer::setParticipantIndex(std::shared_ptr<const ParticipantIndex> index) {
+        pimpl->index = std::move(index);
+    }
+
+    void BalanceOptimizer::setNumOfThreads(unsigned threads) {
+        pimpl->num_threads = threads;
     }
 
+    void BalanceOptimizer::setVerbose(bool verbose) {
+        pimpl->verbose = verbose;
+    }
+
+    void BalanceOptimizer::setOpeningBalances(const std::map<std::string, double>& balances) {
+        pimpl->opening_balances = balances;
+    }
+
+    std::vector<Utils::Debt> BalanceOptimizer::getTransfers() const {
+        return pimpl->collectTransfers();
+    }
+
+    void BalanceOptimizer::setWarmStart(bool warm_start) {
+        pimpl->warm_start = warm_start;
+    }
+
+    void BalanceOptimizer::setTimeBudget(std::chrono::milliseconds budget) {
+        pimpl->time_budget = budget;
+    }
+
+    std::vector<std::pair<double, int>> BalanceOptimizer::getSearchTrajectory() const {
+        return pimpl->trajectory;
+    }
+
+    OptimizerStatus BalanceOptimizer::printParticipantTransfers(const std::string& name) const {
+        std::string out;
+        OptimizerStatus status = pimpl->formatTransfers(name, out);
+        std::cout << out;
+        return status;
+    }
 
     OptimizerStatus BalanceOptimizer::printParticipantExpenses(const std::string& name) const {
-        if (pimpl->result.find(name) == pimpl->result.end()) {
-            return OptimizerStatus::NAME_NOT_FOUND;
-        }
-        const TransferSummary summary = pimpl->result.at(name);
-        
-        std::cout << "Expense Breakdown " << std::endl;
-        for (auto expense_wptr: summary.getExpenses()) {
-            if (expense_wptr.expired())  return OptimizerStatus::OUT_OF_TIME;
-            auto expense_sptr = expense_wptr.lock();
-            //all the attributes
-            double total_amount = expense_sptr->getAmount();
-            int share =expense_sptr->getWeight(name);
-            int total_weight = expense_sptr->getWeightSum();
-            double amount = total_amount * static_cast<double>(share) / static_cast<double>(total_weight);
-            printf("$%-8.2f%-30s(%d out of %d)\n", amount, expense_sptr->getNote().c_str()
-                    , share, total_weight);
-        }
-        printf("Total amount of expense:    $%-.2f\n", summary.getTotalExpense());
-        std::cout << std::endl;
-
-        auto expense_paid = summary.getPayments();
-        if (!expense_paid.empty()) {
-            std::cout << "Expense paid by " << name << std::endl;
-            for (auto& expense_wptr: expense_paid) {
-                auto expense_sptr = expense_wptr.lock();
-                double total_amount = expense_sptr->getAmount();
-                printf("$%-8.2f%-15s\n", total_amount, expense_sptr->getNote().c_str());
-            }
-            printf("Total payment made:         $%-.2f\n", summary.getPaymentMadeValue());
-        }
-        else {
-            std::cout << "No payment was made by " << name << std::endl;
-        }
-        return OptimizerStatus::SUCCESS;
+        std::string out;
+        OptimizerStatus status = pimpl->formatExpenses(name, nullptr, out);
+        std::cout << out;
+        return status;
     }
 
     OptimizerStatus BalanceOptimizer::printParticipantSummary(const std::string& name) const {
-        if (pimpl->result.find(name) == pimpl->result.end()) {
-            return OptimizerStatus::NAME_NOT_FOUND;
-        }
-        std::cout << std::string(60, '-') << std::endl;
-        int padding = (60 - name.size()) / 2 - 4;
-        if (padding < 0)    padding = 0;
-        std::string leftPadding = std::string(padding, '-');
-        std::string rightPadding = name.size() % 2? std::string(padding + 1, '-'): leftPadding;
-        std::cout << leftPadding<< std::string(4, ' ') << name 
-            << std::string(4, ' ') << rightPadding << std::endl;
-        std::cout << std::endl;
-        OptimizerStatus return_code = printParticipantExpenses(name);
-        if (return_code != OptimizerStatus::SUCCESS) {
-            return return_code;
-        }
-        std::cout << std::endl;
-        return_code = printParticipantTransfers(name);
-        if (return_code != OptimizerStatus::SUCCESS)
-            return return_code;
-        std::cout << std::endl;
-        return OptimizerStatus::SUCCESS;
+        std::string out;
+        OptimizerStatus status = pimpl->formatSummary(name, nullptr, out);
+        std::cout << out;
+        return status;
+    }
+
+    OptimizerStatus BalanceOptimizer::printAllSummaries() const {
+        std::vector<const std::string*> names;
+        names.reserve(pimpl->result.size());
+        for (auto& entry: pimpl->result) {
+            names.push_back(&entry.first);
+        }
+        //every expense is converted and its note copied once for the whole report
+        ExpenseFacts facts;
+        facts.reserve(pimpl->result.size());
+        auto addFacts = [&facts, this] (const Expense& expense) {
+            if (facts.count(&expense))  return;
+            facts.emplace(&expense, ExpenseFact{
+                    pimpl->rates.toBase(expense.getAmount(), expense.getCurrency()),
+                    expense.getWeightSum(), expense.getNote()});
+        };
+        for (auto& entry: pimpl->result) {
+            if (pimpl->index) {
+                for (auto& posting: pimpl->index->getPostings(entry.first)) {
+                    addFacts(*pimpl->index->getExpense(posting.expense_id));
+                }
+                for (auto& expense_sptr: pimpl->index->paymentsOf(entry.first)) {
+                    addFacts(*expense_sptr);
+                }
+                continue;
+            }
+            for (auto* list: {&entry.second.getExpenses(), &entry.second.getPayments()}) {
+                for (auto& expense_wptr: *list) {
+                    auto expense_sptr = expense_wptr.lock();
+                    if (expense_sptr)   addFacts(*expense_sptr);
+                }
+            }
+        }
+
+        //contiguous blocks of names go to the workers, each block into a buffer of its own,
+        //the buffers are printed in block order, which is the name order
+        const std::size_t num_blocks = (names.size() + report_block - 1) / report_block;
+        std::vector<std::string> buffers(num_blocks);
+        std::vector<OptimizerStatus> statuses(num_blocks, OptimizerStatus::SUCCESS);
+        WorkStealingPool pool(pimpl->num_threads);
+        pool.run(num_blocks, [&] (std::size_t block) {
+            std::size_t last = std::min(names.size(), (block + 1) * report_block);
+            for (std::size_t pos = block * report_block; pos < last; ++pos) {
+                OptimizerStatus status = pimpl->formatSummary(*names[pos], &facts, buffers[block]);
+                if (statuses[block] == OptimizerStatus::SUCCESS)    statuses[block] = status;
+            }
+        });
+        OptimizerStatus res = OptimizerStatus::SUCCESS;
+        for (std::size_t block = 0; block < num_blocks; ++block) {
+            std::cout << buffers[block];
+            if (res == OptimizerStatus::SUCCESS)    res = statuses[block];
+        }
+        return res;
     }
 
 
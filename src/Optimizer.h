@@ -5,9 +5,13 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <map>
+#include <memory>
 
 #include "Expense.h"
+#include "Currency.h"
 #include "utils.h"
+#include "TransferWriter.h"
 
 namespace AccountBalancer {
     enum class OptimizerStatus {
@@ -19,7 +23,11 @@ namespace AccountBalancer {
 
     enum class OptimizerStrategy {
         LEAST_TRANSFER,
-        LAZY
+        LAZY,
+        //only transfers in the allowed set can happen, minimize the total amount moved
+        CONSTRAINED,
+        //near least transfers for large ledgers, improved until the time budget runs out
+        LOCAL_SEARCH
     };
 
     struct Transfer {
@@ -33,27 +41,110 @@ namespace AccountBalancer {
     };
 
 
+    //a list of [name, gap] pairs, see getExpenseGaps for the definition of gaps
+    using GapList = std::vector<std::pair<std::string, double>>;
+
+    class ResultCache;
+    class ParticipantIndex;
+
     class BalanceOptimizer {
     private:
         struct BalanceOptimizerImpl;
         std::unique_ptr<BalanceOptimizerImpl> pimpl;
 
-        OptimizerStatus lazyOptimize();
+        OptimizerStatus lazyOptimize(GapList& creditor_gaps, GapList& debtor_gaps);
+
+        OptimizerStatus leastTransferOptimize(GapList& creditor_gaps, GapList& debtor_gaps);
+
+        OptimizerStatus constrainedOptimize(GapList& creditor_gaps, GapList& debtor_gaps);
+
+        OptimizerStatus localSearchOptimize(GapList& creditor_gaps, GapList& debtor_gaps);
+
+        OptimizerStatus runStrategy(OptimizerStrategy strategy, GapList& creditor_gaps,
+                GapList& debtor_gaps);
 
-        OptimizerStatus leastTransferOptimize();
+        OptimizerStatus warmStartOptimize(const std::map<std::string, long long>& gaps,
+                OptimizerStrategy strategy);
+
+        //run the strategy with every transfer going to the sink instead of the result
+        OptimizerStatus runToSink(OptimizerStrategy strategy, GapList& creditor_gaps,
+                GapList& debtor_gaps, const TransferSink& sink);
 
     public:
         BalanceOptimizer();
 
         ~BalanceOptimizer();
 
-        //test whether this optimizer is a valid (newer than the given time)
+        //test whether this optimizer is a valid (the last successful optimizeExpenses is
+        //newer than the given time)
         bool isUpToTime(const std::chrono::time_point<std::chrono::system_clock>& time_point) const;
 
         //given a set of expenses, optimize it, return status code
+        //amounts are normalized into the base currency of the exchange rates first,
+        //FAILED is returned if an expense is in a currency without a rate
         OptimizerStatus optimizeExpenses(const std::vector<std::shared_ptr<Expense>>& expenses,
                 OptimizerStrategy);
 
+        //optimize the expenses and hand every transfer to the sink as soon as it is found,
+        //only the net balances are aggregated, the per-person summaries, the cache and the
+        //last result are not touched, so the print methods still report the last optimize
+        OptimizerStatus exportTransfers(const std::vector<std::shared_ptr<Expense>>& expenses,
+                OptimizerStrategy strategy, const TransferSink& sink);
+
+        //what-if: the transfers if these expenses were added to the ledger of the last
+        //optimizeExpenses, the hypothetical balance changes are laid over the balances of
+        //the last run without copying them, the ledger, the last result and the cache stay
+        //as they are, transfers are [creditor, debtor, amount]
+        //FAILED if an expense has no share weight (or no participant) to split by
+        OptimizerStatus simulateExpenses(const std::vector<std::shared_ptr<Expense>>& expenses,
+                OptimizerStrategy strategy, std::vector<Utils::Debt>& transfers);
+
+        //the result cache, every optimizer owns one by default, share a single cache
+        //between optimizers so that identical balance states are solved only once,
+        //setting it to nullptr disables caching
+        std::shared_ptr<ResultCache> getResultCache() const;
+        void setResultCache(std::shared_ptr<ResultCache> cache);
+
+        //restrict the transfers for the constrained strategy, each pair is [payer, payee]
+        //money may be relayed through other participants when there is no direct pair
+        void setAllowedTransfers(const std::vector<std::pair<std::string, std::string>>& pairs);
+
+        //the exchange rates of the ledger, by default every expense is in the base currency
+        void setExchangeRates(const ExchangeRates& rates);
+
+        //express the transfers this person pays in the given currency when printing
+        void setPreferredCurrency(const std::string& name, const std::string& currency);
+
+        //use the inverted index of the ledger for the expense breakdowns, the index has to
+        //cover the same expenses, per-person expense lists are then not rebuilt on every run
+        void setParticipantIndex(std::shared_ptr<const ParticipantIndex> index);
+
+        //threads used by the exact least transfer search, 0 (the default) means one per
+        //hardware thread, the transfers found do not depend on the number of threads
+        void setNumOfThreads(unsigned threads);
+
+        //report what the optimization did (pairs settled up front, search budget) on cerr
+        void setVerbose(bool verbose);
+
+        //balances carried forward from closed epochs, positive means being owed, they are
+        //part of every optimization along with the expenses of the current epoch
+        void setOpeningBalances(const std::map<std::string, double>& balances);
+
+        //the transfers of the last optimization, [creditor, debtor, amount]
+        std::vector<Utils::Debt> getTransfers() const;
+
+        //start from the plan of the last run: transfers between participants whose balance
+        //did not change are kept and only the rest is solved again, so that a new expense
+        //only moves the transfers of the people it touches, the plan may then need a few
+        //more transfers than solving from scratch, off by default
+        void setWarmStart(bool warm_start);
+
+        //time the local search strategy may take, one second by default
+        void setTimeBudget(std::chrono::milliseconds budget);
+
+        //[seconds into the search, transfers] every time the last local search improved
+        std::vector<std::pair<double, int>> getSearchTrajectory() const;
+
         //output a single person's transfers
         OptimizerStatus printParticipantTransfers(const std::string& name) const;
 
@@ -62,6 +153,11 @@ namespace AccountBalancer {
 
         //print a single person's expense summary, an overall report for expense and transfer
         OptimizerStatus printParticipantSummary(const std::string& name) const;
+
+        //the summaries of every participant in name order, the sections are formatted in
+        //parallel by the worker threads, each into a buffer of its own, and printed in order
+        //return the first status other than SUCCESS, after printing everything else
+        OptimizerStatus printAllSummaries() const;
     };
 
     //a summary for a single participants containing
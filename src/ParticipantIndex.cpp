@@ -0,0 +1,170 @@
+//implement the participant to expense inverted index
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#include "ParticipantIndex.h"
+#include "NameTable.h"
+
+namespace AccountBalancer {
+    struct ParticipantIndex::ParticipantIndexImpl {
+        //shared with the indexed expenses, which keep their participant IDs over it
+        std::shared_ptr<NameTable> names = std::make_shared<NameTable>();
+        //expense ID to expense, removed expenses leave a nullptr behind
+        std::vector<std::shared_ptr<Expense>> expenses;
+        std::unordered_map<const Expense*, int> expense_ids;
+        //participant ID to the expenses shared
+        std::vector<std::vector<Posting>> postings;
+        //participant ID to the IDs of expenses paid
+        std::vector<std::vector<int>> payments;
+
+        int idOf(const std::string& name) {
+            int id = names->intern(name);
+            if (id == static_cast<int>(postings.size())) {
+                postings.emplace_back();
+                payments.emplace_back();
+            }
+            return id;
+        }
+    };
+
+    ParticipantIndex::ParticipantIndex(): pimpl(std::make_unique<ParticipantIndexImpl>()) {}
+
+    ParticipantIndex::~ParticipantIndex() = default;
+
+    int ParticipantIndex::addExpense(std::shared_ptr<Expense> expense) {
+        auto found = pimpl->expense_ids.find(expense.get());
+        if (found != pimpl->expense_ids.end())  return found->second;
+        //IDs only grow, so appending keeps every posting list sorted
+        int expense_id = pimpl->expenses.size();
+        expense->internParticipants(pimpl->names);
+        for (auto& weight: expense->getWeightsMap()) {
+            pimpl->postings[pimpl->idOf(weight.first)].push_back(Posting{expense_id, weight.second});
+        }
+        pimpl->payments[pimpl->idOf(expense->getCreditor())].push_back(expense_id);
+        pimpl->expense_ids.emplace(expense.get(), expense_id);
+        pimpl->expenses.push_back(std::move(expense));
+        return expense_id;
+    }
+
+    void ParticipantIndex::removeExpense(const std::shared_ptr<Expense>& expense) {
+        auto found = pimpl->expense_ids.find(expense.get());
+        if (found == pimpl->expense_ids.end())  return;
+        int expense_id = found->second;
+        auto posting_less = [] (const Posting& posting, int id) -> bool {
+            return posting.expense_id < id;
+        };
+        for (auto& weight: expense->getWeightsMap()) {
+            auto& list = pimpl->postings[pimpl->names->find(weight.first)];
+            auto it = std::lower_bound(list.begin(), list.end(), expense_id, posting_less);
+            if (it != list.end() && it->expense_id == expense_id)   list.erase(it);
+        }
+        auto& paid = pimpl->payments[pimpl->names->find(expense->getCreditor())];
+        auto it = std::lower_bound(paid.begin(), paid.end(), expense_id);
+        if (it != paid.end() && *it == expense_id)  paid.erase(it);
+        pimpl->expenses[expense_id].reset();
+        pimpl->expense_ids.erase(found);
+    }
+
+    std::shared_ptr<Expense> ParticipantIndex::getExpense(int expense_id) const {
+        return pimpl->expenses.at(expense_id);
+    }
+
+    const std::vector<ParticipantIndex::Posting>& ParticipantIndex::getPostings(
+            const std::string& name) const {
+        static const std::vector<Posting> empty;
+        int id = pimpl->names->find(name);
+        return id < 0? empty: pimpl->postings[id];
+    }
+
+    std::vector<std::shared_ptr<Expense>> ParticipantIndex::expensesOf(const std::string& name) const {
+        std::vector<std::shared_ptr<Expense>> res;
+        for (auto& posting: getPostings(name)) {
+            res.push_back(pimpl->expenses[posting.expense_id]);
+        }
+        return res;
+    }
+
+    std::vector<std::shared_ptr<Expense>> ParticipantIndex::paymentsOf(const std::string& name) const {
+        std::vector<std::shared_ptr<Expense>> res;
+        int id = pimpl->names->find(name);
+        if (id < 0) return res;
+        for (int expense_id: pimpl->payments[id]) {
+            res.push_back(pimpl->expenses[expense_id]);
+        }
+        return res;
+    }
+
+    std::vector<std::shared_ptr<Expense>> ParticipantIndex::sharedExpenses(const std::string& a,
+            const std::string& b) const {
+        return sharedExpenses(std::vector<std::string>{a, b});
+    }
+
+    std::vector<std::shared_ptr<Expense>> ParticipantIndex::sharedExpenses(
+            const std::vector<std::string>& names) const {
+        //walk the shortest posting list, and test the interned participants of every
+        //expense on it against the IDs of all the names
+        std::vector<std::shared_ptr<Expense>> res;
+        std::vector<int> query;
+        const std::vector<Posting>* shortest = nullptr;
+        for (auto& name: names) {
+            int id = pimpl->names->find(name);
+            if (id < 0) return res;
+            query.push_back(id);
+            if (!shortest || pimpl->postings[id].size() < shortest->size()) {
+                shortest = &pimpl->postings[id];
+            }
+        }
+        if (!shortest)  return res;
+        for (auto& posting: *shortest) {
+            auto& expense = pimpl->expenses[posting.expense_id];
+            bool shared = true;
+            for (std::size_t pos = 0; shared && pos < query.size(); ++pos) {
+                shared = expense->hasParticipant(query[pos]);
+            }
+            if (shared) res.push_back(expense);
+        }
+        return res;
+    }
+
+    std::shared_ptr<const NameTable> ParticipantIndex::getNameTable() const {
+        return pimpl->names;
+    }
+
+    bool ParticipantIndex::printParticipantExpenses(const std::string& name,
+            const ExchangeRates& rates) const {
+        int id = pimpl->names->find(name);
+        if (id < 0) return false;
+
+        std::cout << "Expense Breakdown " << std::endl;
+        double total_expense = 0.0;
+        for (auto& posting: pimpl->postings[id]) {
+            const Expense& expense = *pimpl->expenses[posting.expense_id];
+            double total_amount = rates.toBase(expense.getAmount(), expense.getCurrency());
+            int total_weight = expense.getWeightSum();
+            double amount = total_amount * static_cast<double>(posting.weight) / static_cast<double>(total_weight);
+            total_expense += amount;
+            printf("$%-8.2f%-30s(%d out of %d)\n", amount, expense.getNote().c_str(),
+                    posting.weight, total_weight);
+        }
+        printf("Total amount of expense:    $%-.2f\n", total_expense);
+        std::cout << std::endl;
+
+        auto& paid = pimpl->payments[id];
+        if (!paid.empty()) {
+            std::cout << "Expense paid by " << name << std::endl;
+            double payment_made = 0.0;
+            for (int expense_id: paid) {
+                const Expense& expense = *pimpl->expenses[expense_id];
+                double total_amount = rates.toBase(expense.getAmount(), expense.getCurrency());
+                payment_made += total_amount;
+                printf("$%-8.2f%-15s\n", total_amount, expense.getNote().c_str());
+            }
+            printf("Total payment made:         $%-.2f\n", payment_made);
+        }
+        else {
+            std::cout << "No payment was made by " << name << std::endl;
+        }
+        return true;
+    }
+} //AccountBalancer
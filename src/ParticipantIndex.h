@@ -0,0 +1,69 @@
+//An inverted index from participants to the committed expenses they share
+//every participant has a posting list of [expense ID, share weight] sorted by expense ID,
+//it is kept up to date on commit and undo, so that the expenses of a single person
+//can be listed in O(k) without running the optimizer
+//indexed expenses are interned into the name table of the index, so that they carry their
+//participant IDs, which makes a query on several participants a lookup of integers
+#ifndef __BALANCE_PARTICIPANT_INDEX_H
+#define __BALANCE_PARTICIPANT_INDEX_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Currency.h"
+#include "Expense.h"
+
+namespace AccountBalancer {
+    class NameTable;
+
+    class ParticipantIndex {
+    private:
+        struct ParticipantIndexImpl;
+        std::unique_ptr<ParticipantIndexImpl> pimpl;
+
+    public:
+        struct Posting {
+            int expense_id;
+            int weight;
+        };
+
+        ParticipantIndex();
+
+        ~ParticipantIndex();
+
+        //index a committed expense, return the ID assigned to it
+        int addExpense(std::shared_ptr<Expense> expense);
+
+        //remove an expense from the index (undo), nothing happens if it is not indexed
+        void removeExpense(const std::shared_ptr<Expense>& expense);
+
+        //nullptr if the expense is removed
+        std::shared_ptr<Expense> getExpense(int expense_id) const;
+
+        //the posting list of a participant, sorted by expense ID
+        const std::vector<Posting>& getPostings(const std::string& name) const;
+
+        //the expenses a participant shares
+        std::vector<std::shared_ptr<Expense>> expensesOf(const std::string& name) const;
+
+        //the expenses a participant paid for
+        std::vector<std::shared_ptr<Expense>> paymentsOf(const std::string& name) const;
+
+        //the expenses shared by both participants
+        std::vector<std::shared_ptr<Expense>> sharedExpenses(const std::string& a,
+                const std::string& b) const;
+
+        //the expenses shared by all the participants
+        std::vector<std::shared_ptr<Expense>> sharedExpenses(
+                const std::vector<std::string>& names) const;
+
+        //the IDs of the interned participants of the indexed expenses
+        std::shared_ptr<const NameTable> getNameTable() const;
+
+        //print the expense breakdown and the payments of a participant
+        //return false if the participant is not in any expense
+        bool printParticipantExpenses(const std::string& name,
+                const ExchangeRates& rates = ExchangeRates()) const;
+    };
+} //AccountBalancer
+#endif
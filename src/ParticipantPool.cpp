@@ -0,0 +1,129 @@
+//implement the participant pool
+#include <algorithm>
+#include <functional>
+
+#include "ParticipantPool.h"
+
+namespace {
+    constexpr std::size_t initial_slots = 64;
+
+    //how many names ahead the batch check prefetches
+    constexpr std::size_t prefetch_distance = 8;
+} //anonymous namespace
+
+namespace AccountBalancer {
+    ParticipantPool::ParticipantPool():
+        slots(initial_slots, Slot{0, 0}),
+        num_active(0) {}
+
+    std::size_t ParticipantPool::hashOf(const std::string& name) {
+        return std::hash<std::string>()(name);
+    }
+
+    int ParticipantPool::find(const std::string& name, std::size_t hash) const {
+        const std::size_t mask = slots.size() - 1;
+        const std::uint32_t tag = static_cast<std::uint32_t>(hash >> 32);
+        for (std::size_t pos = hash & mask; ; pos = (pos + 1) & mask) {
+            const Slot& slot = slots[pos];
+            if (!slot.id)   return -1;
+            if (slot.tag == tag && names[slot.id - 1] == name)  return slot.id - 1;
+        }
+    }
+
+    void ParticipantPool::reserve(std::size_t count) {
+        if (2 * count <= slots.size())  return;
+        std::size_t capacity = slots.size();
+        while (2 * count > capacity) {
+            capacity *= 2;
+        }
+        std::vector<Slot> grown(capacity, Slot{0, 0});
+        const std::size_t mask = capacity - 1;
+        for (std::size_t id = 0; id < names.size(); ++id) {
+            std::size_t hash = hashOf(names[id]);
+            std::size_t pos = hash & mask;
+            while (grown[pos].id) {
+                pos = (pos + 1) & mask;
+            }
+            grown[pos] = Slot{static_cast<std::uint32_t>(hash >> 32), static_cast<std::uint32_t>(id + 1)};
+        }
+        slots.swap(grown);
+    }
+
+    bool ParticipantPool::insert(const std::string& name) {
+        std::size_t hash = hashOf(name);
+        int id = find(name, hash);
+        if (id < 0) {
+            reserve(names.size() + 1);
+            const std::size_t mask = slots.size() - 1;
+            std::size_t pos = hash & mask;
+            while (slots[pos].id) {
+                pos = (pos + 1) & mask;
+            }
+            id = names.size();
+            slots[pos] = Slot{static_cast<std::uint32_t>(hash >> 32), static_cast<std::uint32_t>(id + 1)};
+            names.push_back(name);
+            active.push_back(0);
+        }
+        if (active[id]) return false;
+        active[id] = 1;
+        ++num_active;
+        return true;
+    }
+
+    std::size_t ParticipantPool::insert(const std::vector<std::string>& _names) {
+        reserve(names.size() + _names.size());
+        std::size_t added = 0;
+        for (auto& name: _names) {
+            if (insert(name))   ++added;
+        }
+        return added;
+    }
+
+    bool ParticipantPool::erase(const std::string& name) {
+        int id = find(name, hashOf(name));
+        if (id < 0 || !active[id])  return false;
+        active[id] = 0;
+        --num_active;
+        return true;
+    }
+
+    bool ParticipantPool::contains(const std::string& name) const {
+        int id = find(name, hashOf(name));
+        return id >= 0 && active[id];
+    }
+
+    std::size_t ParticipantPool::findMissing(const std::vector<std::string>& _names) const {
+        const std::size_t count = _names.size();
+        const std::size_t mask = slots.size() - 1;
+        //hash everything first, the probes then only wait on memory
+        std::vector<std::size_t> hashes(count);
+        for (std::size_t pos = 0; pos < count; ++pos) {
+            hashes[pos] = hashOf(_names[pos]);
+        }
+        for (std::size_t pos = 0; pos < std::min(count, prefetch_distance); ++pos) {
+            __builtin_prefetch(&slots[hashes[pos] & mask]);
+        }
+        for (std::size_t pos = 0; pos < count; ++pos) {
+            if (pos + prefetch_distance < count) {
+                __builtin_prefetch(&slots[hashes[pos + prefetch_distance] & mask]);
+            }
+            int id = find(_names[pos], hashes[pos]);
+            if (id < 0 || !active[id])  return pos;
+        }
+        return count;
+    }
+
+    std::size_t ParticipantPool::size() const noexcept {
+        return num_active;
+    }
+
+    std::vector<std::string> ParticipantPool::sortedNames() const {
+        std::vector<std::string> res;
+        res.reserve(num_active);
+        for (std::size_t id = 0; id < names.size(); ++id) {
+            if (active[id]) res.push_back(names[id]);
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+} //AccountBalancer
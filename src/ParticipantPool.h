@@ -0,0 +1,59 @@
+//The pool of participants of a ledger
+//names are interned into IDs and looked up through an open addressing hash table (linear
+//probing over a flat array of [hash tag, ID] slots), a removed participant keeps its ID and
+//is only marked inactive, so slots are never deleted and probing never meets a tombstone
+#ifndef __BALANCE_PARTICIPANT_POOL_H
+#define __BALANCE_PARTICIPANT_POOL_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AccountBalancer {
+    class ParticipantPool {
+    public:
+        ParticipantPool();
+
+        //return whether the name was not in the pool yet
+        bool insert(const std::string& name);
+
+        //add all the names with a single resize, return the number of names newly added
+        std::size_t insert(const std::vector<std::string>& names);
+
+        //return whether the name was in the pool
+        bool erase(const std::string& name);
+
+        bool contains(const std::string& name) const;
+
+        //check a whole participant list in one pass, the slots of the names a few positions
+        //ahead are prefetched while the current one is probed
+        //return the position of the first name not in the pool, names.size() if all are in
+        std::size_t findMissing(const std::vector<std::string>& names) const;
+
+        std::size_t size() const noexcept;
+
+        //the participants sorted by name
+        std::vector<std::string> sortedNames() const;
+
+    private:
+        struct Slot {
+            //the high bits of the hash, to skip most string comparisons
+            std::uint32_t tag;
+            //ID + 1, 0 marks an empty slot
+            std::uint32_t id;
+        };
+
+        std::vector<Slot> slots;
+        std::vector<std::string> names;
+        std::vector<char> active;
+        std::size_t num_active;
+
+        static std::size_t hashOf(const std::string& name);
+
+        //the ID of the name, -1 if it was never interned
+        int find(const std::string& name, std::size_t hash) const;
+
+        //make room for the given number of interned names at most half full
+        void reserve(std::size_t count);
+    };
+} //AccountBalancer
+#endif
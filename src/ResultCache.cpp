@@ -0,0 +1,200 @@
+//implement the optimization result cache
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <list>
+#include <sstream>
+#include <unordered_map>
+
+#include "ResultCache.h"
+#include "Optimizer.h"
+
+namespace {
+    constexpr std::uint64_t fnv_offset_basis = 14695981039346656037ULL;
+    constexpr std::uint64_t fnv_prime = 1099511628211ULL;
+
+    std::uint64_t fnv1a(const std::string& str) {
+        std::uint64_t hash = fnv_offset_basis;
+        for (unsigned char c: str) {
+            hash ^= c;
+            hash *= fnv_prime;
+        }
+        return hash;
+    }
+
+    //a cache file may be truncated or corrupted, so a token must be a number from
+    //end to end, return false instead of throwing
+    bool parseCount(const std::string& token, std::size_t& count) {
+        if (token.empty() || token[0] < '0' || token[0] > '9')  return false;
+        char* end = nullptr;
+        errno = 0;
+        unsigned long value = std::strtoul(token.c_str(), &end, 10);
+        if (errno || *end)  return false;
+        count = value;
+        return true;
+    }
+
+    bool parseAmount(const std::string& token, double& amount) {
+        if (token.empty())  return false;
+        char* end = nullptr;
+        errno = 0;
+        amount = std::strtod(token.c_str(), &end);
+        return !errno && !*end && std::isfinite(amount);
+    }
+} //anonymous namespace
+
+namespace AccountBalancer {
+    struct ResultCache::ResultCacheImpl {
+        struct Entry {
+            Key key;
+            std::vector<Utils::Debt> transfers;
+        };
+        std::size_t capacity;
+        //most recently used in the front
+        std::list<Entry> entries;
+        std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+
+        ResultCacheImpl(std::size_t _capacity): capacity(_capacity) {}
+
+        void evict() {
+            while (entries.size() > capacity) {
+                index.erase(entries.back().key.hash);
+                entries.pop_back();
+            }
+        }
+    };
+
+    ResultCache::ResultCache(std::size_t capacity):
+        pimpl(std::make_unique<ResultCacheImpl>(capacity)) {}
+
+    ResultCache::~ResultCache() = default;
+
+    ResultCache::Key ResultCache::makeKey(
+            const std::vector<std::pair<std::string, double>>& creditor_gaps,
+            const std::vector<std::pair<std::string, double>>& debtor_gaps,
+            OptimizerStrategy strategy, std::chrono::milliseconds time_budget) {
+        std::vector<std::pair<std::string, long long>> gaps;
+        gaps.reserve(creditor_gaps.size() + debtor_gaps.size());
+        for (auto& gap: creditor_gaps) {
+            gaps.push_back(std::make_pair(gap.first, std::llround(gap.second * 100.0)));
+        }
+        for (auto& gap: debtor_gaps) {
+            gaps.push_back(std::make_pair(gap.first, -std::llround(gap.second * 100.0)));
+        }
+        std::sort(gaps.begin(), gaps.end());
+        std::stringstream ss;
+        ss << static_cast<int>(strategy) << ";";
+        if (strategy == OptimizerStrategy::LOCAL_SEARCH) {
+            ss << time_budget.count() << "ms;";
+        }
+        for (auto& gap: gaps) {
+            //gaps that round to zero cents do not change the plan
+            if (gap.second == 0)    continue;
+            ss << gap.first << ":" << gap.second << ";";
+        }
+        Key key;
+        key.canonical = ss.str();
+        key.hash = fnv1a(key.canonical);
+        return key;
+    }
+
+    bool ResultCache::lookup(const Key& key, std::vector<Utils::Debt>& transfers) {
+        auto it = pimpl->index.find(key.hash);
+        if (it == pimpl->index.end() || it->second->key.canonical != key.canonical) {
+            return false;
+        }
+        //move to the front
+        pimpl->entries.splice(pimpl->entries.begin(), pimpl->entries, it->second);
+        transfers = it->second->transfers;
+        return true;
+    }
+
+    void ResultCache::insert(const Key& key, std::vector<Utils::Debt> transfers) {
+        if (pimpl->capacity == 0)   return;
+        auto it = pimpl->index.find(key.hash);
+        if (it != pimpl->index.end()) {
+            //either a refresh or a hash collision, the newer plan wins
+            pimpl->entries.erase(it->second);
+            pimpl->index.erase(it);
+        }
+        pimpl->entries.push_front(ResultCacheImpl::Entry{key, std::move(transfers)});
+        pimpl->index[key.hash] = pimpl->entries.begin();
+        pimpl->evict();
+    }
+
+    std::size_t ResultCache::size() const noexcept {
+        return pimpl->entries.size();
+    }
+
+    std::size_t ResultCache::capacity() const noexcept {
+        return pimpl->capacity;
+    }
+
+    void ResultCache::setCapacity(std::size_t capacity) {
+        pimpl->capacity = capacity;
+        pimpl->evict();
+    }
+
+    void ResultCache::clear() noexcept {
+        pimpl->entries.clear();
+        pimpl->index.clear();
+    }
+
+    //one entry per line, least recently used first so that loading keeps the order:
+    //canonical_key number_of_transfers [creditor debtor amount]...
+    bool ResultCache::saveToFile(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "can not open " << path << " for writing" << std::endl;
+            return false;
+        }
+        out << std::setprecision(17);
+        for (auto it = pimpl->entries.rbegin(); it != pimpl->entries.rend(); ++it) {
+            out << it->key.canonical << " " << it->transfers.size();
+            for (auto& transfer: it->transfers) {
+                out << " " << transfer.creditor << " " << transfer.debtor
+                    << " " << transfer.amount;
+            }
+            out << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+
+    bool ResultCache::loadFromFile(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "can not open " << path << " for reading" << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            std::vector<std::string> tokens = Utils::splitLine(line);
+            if (tokens.size() < 2) continue;
+            std::size_t count = 0;
+            if (!parseCount(tokens[1], count) || (tokens.size() - 2) % 3
+                    || count != (tokens.size() - 2) / 3) {
+                std::cerr << "ignore malformed cache entry" << std::endl;
+                continue;
+            }
+            std::vector<Utils::Debt> transfers;
+            bool valid = true;
+            for (std::size_t pos = 2; valid && pos < tokens.size(); pos += 3) {
+                double amount = 0.0;
+                valid = parseAmount(tokens[pos + 2], amount);
+                transfers.push_back(Utils::Debt(tokens[pos], tokens[pos + 1], amount));
+            }
+            if (!valid) {
+                std::cerr << "ignore malformed cache entry" << std::endl;
+                continue;
+            }
+            Key key;
+            key.canonical = tokens[0];
+            key.hash = fnv1a(key.canonical);
+            insert(key, std::move(transfers));
+        }
+        return true;
+    }
+} //AccountBalancer
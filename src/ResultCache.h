@@ -0,0 +1,62 @@
+//A least-recently-used cache of optimization results
+//the key is a canonical form of the balance state (non-zero gaps + strategy), so that
+//ledgers which are identical in net terms share the same transfer plan
+#ifndef __BALANCE_RESULT_CACHE_H
+#define __BALANCE_RESULT_CACHE_H
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+namespace AccountBalancer {
+    enum class OptimizerStrategy;
+
+    class ResultCache {
+    private:
+        struct ResultCacheImpl;
+        std::unique_ptr<ResultCacheImpl> pimpl;
+
+    public:
+        //a canonical key, the hash is used for lookup and the canonical string
+        //is kept to resolve collisions
+        struct Key {
+            std::uint64_t hash;
+            std::string canonical;
+        };
+
+        explicit ResultCache(std::size_t capacity = 64);
+
+        ~ResultCache();
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        //build the canonical key from the creditor and debtor gaps (both positive),
+        //gaps are rounded to cents and sorted by name so the order of expenses never matters,
+        //the local search plan also depends on how long it ran, so its time budget is part
+        //of the key, the budget is ignored for the other strategies
+        static Key makeKey(const std::vector<std::pair<std::string, double>>& creditor_gaps,
+                const std::vector<std::pair<std::string, double>>& debtor_gaps,
+                OptimizerStrategy strategy,
+                std::chrono::milliseconds time_budget = std::chrono::milliseconds::zero());
+
+        //look up a cached transfer plan, a hit marks the entry as most recently used
+        bool lookup(const Key& key, std::vector<Utils::Debt>& transfers);
+
+        //insert a transfer plan, evict the least recently used entry if full
+        void insert(const Key& key, std::vector<Utils::Debt> transfers);
+
+        std::size_t size() const noexcept;
+        std::size_t capacity() const noexcept;
+        void setCapacity(std::size_t capacity);
+        void clear() noexcept;
+
+        //persist to/restore from disk, so the cache survives sessions
+        bool saveToFile(const std::string& path) const;
+        bool loadFromFile(const std::string& path);
+    };
+} //AccountBalancer
+#endif
@@ -0,0 +1,90 @@
+//implement the transfer writers
+#include <cmath>
+#include <cstdio>
+
+#include "TransferWriter.h"
+
+namespace AccountBalancer {
+    CsvTransferWriter::CsvTransferWriter(std::ostream& _out): out(_out), count(0) {
+        out << "payer,payee,amount\n";
+    }
+
+    void CsvTransferWriter::writeName(const std::string& name) {
+        if (name.find_first_of(",\"\n") == std::string::npos) {
+            out << name;
+            return;
+        }
+        out << '"';
+        for (char c: name) {
+            if (c == '"')   out << '"';
+            out << c;
+        }
+        out << '"';
+    }
+
+    void CsvTransferWriter::write(const std::string& payer, const std::string& payee, double amount) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2f", amount);
+        writeName(payer);
+        out << ',';
+        writeName(payee);
+        out << ',' << buffer << '\n';
+        ++count;
+    }
+
+    TransferSink CsvTransferWriter::sink() {
+        return [this] (const std::string& payer, const std::string& payee, double amount) {
+            write(payer, payee, amount);
+        };
+    }
+
+    std::size_t CsvTransferWriter::numOfTransfers() const noexcept {
+        return count;
+    }
+
+    BinaryTransferWriter::BinaryTransferWriter(std::ostream& _out): out(_out), count(0) {
+        out.write("ABT1", 4);
+    }
+
+    void BinaryTransferWriter::writeVarint(std::uint64_t value) {
+        char buffer[10];
+        int size = 0;
+        do {
+            char byte = static_cast<char>(value & 0x7f);
+            value >>= 7;
+            buffer[size++] = value? static_cast<char>(byte | 0x80): byte;
+        } while (value);
+        out.write(buffer, size);
+    }
+
+    std::uint32_t BinaryTransferWriter::idOf(const std::string& name) {
+        auto found = ids.find(name);
+        if (found != ids.end()) return found->second;
+        std::uint32_t id = ids.size();
+        ids.emplace(name, id);
+        out.put('N');
+        writeVarint(name.size());
+        out.write(name.data(), name.size());
+        return id;
+    }
+
+    void BinaryTransferWriter::write(const std::string& payer, const std::string& payee,
+            double amount) {
+        std::uint32_t from = idOf(payer), to = idOf(payee);
+        out.put('T');
+        writeVarint(from);
+        writeVarint(to);
+        writeVarint(static_cast<std::uint64_t>(std::llround(amount * 100.0)));
+        ++count;
+    }
+
+    TransferSink BinaryTransferWriter::sink() {
+        return [this] (const std::string& payer, const std::string& payee, double amount) {
+            write(payer, payee, amount);
+        };
+    }
+
+    std::size_t BinaryTransferWriter::numOfTransfers() const noexcept {
+        return count;
+    }
+} //AccountBalancer
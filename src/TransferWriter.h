@@ -0,0 +1,61 @@
+//Stream transfers out as they are found, for payout pipelines that only need the flat
+//[payer, payee, amount] list and not the per-person summaries
+#ifndef __BALANCE_TRANSFER_WRITER_H
+#define __BALANCE_TRANSFER_WRITER_H
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace AccountBalancer {
+    //called once per transfer, payer pays the amount (in the base currency) to payee
+    using TransferSink = std::function<void(const std::string& payer, const std::string& payee,
+            double amount)>;
+
+    //one "payer,payee,amount" line per transfer after a header line,
+    //names with a comma or a quote are quoted
+    class CsvTransferWriter {
+    public:
+        explicit CsvTransferWriter(std::ostream& _out);
+
+        void write(const std::string& payer, const std::string& payee, double amount);
+
+        //a sink writing to this writer, the writer has to outlive it
+        TransferSink sink();
+
+        std::size_t numOfTransfers() const noexcept;
+
+    private:
+        std::ostream& out;
+        std::size_t count;
+
+        void writeName(const std::string& name);
+    };
+
+    //a compact binary stream, after the 4-byte magic "ABT1" every record is either
+    //  'N' <length> <bytes>            the next name ID, IDs count up from 0
+    //  'T' <payer ID> <payee ID> <cents>
+    //integers are unsigned LEB128 varints (7 bits a byte, low bits first), every name
+    //is written once on its first transfer, so a transfer usually takes 6 to 10 bytes
+    class BinaryTransferWriter {
+    public:
+        explicit BinaryTransferWriter(std::ostream& _out);
+
+        void write(const std::string& payer, const std::string& payee, double amount);
+
+        //a sink writing to this writer, the writer has to outlive it
+        TransferSink sink();
+
+        std::size_t numOfTransfers() const noexcept;
+
+    private:
+        std::ostream& out;
+        std::size_t count;
+        std::unordered_map<std::string, std::uint32_t> ids;
+
+        std::uint32_t idOf(const std::string& name);
+        void writeVarint(std::uint64_t value);
+    };
+} //AccountBalancer
+#endif
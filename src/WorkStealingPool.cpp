@@ -0,0 +1,82 @@
+//implement the work stealing pool
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingPool.h"
+
+namespace {
+    struct TaskQueue {
+        std::mutex lock;
+        std::deque<std::size_t> tasks;
+
+        bool popFront(std::size_t& index) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (tasks.empty())  return false;
+            index = tasks.front();
+            tasks.pop_front();
+            return true;
+        }
+
+        bool popBack(std::size_t& index) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (tasks.empty())  return false;
+            index = tasks.back();
+            tasks.pop_back();
+            return true;
+        }
+    };
+} //anonymous namespace
+
+namespace AccountBalancer {
+    WorkStealingPool::WorkStealingPool(unsigned threads): num_threads(threads) {
+        if (!num_threads)   num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    unsigned WorkStealingPool::numOfThreads() const noexcept {
+        return num_threads;
+    }
+
+    void WorkStealingPool::run(std::size_t num_tasks,
+            const std::function<void(std::size_t)>& task) const {
+        std::size_t num_workers = std::min<std::size_t>(num_threads, num_tasks);
+        if (num_workers <= 1) {
+            for (std::size_t index = 0; index < num_tasks; ++index) task(index);
+            return;
+        }
+        //no task is added once the run starts, so a worker is done when every queue is empty
+        std::vector<TaskQueue> queues(num_workers);
+        for (std::size_t worker = 0; worker < num_workers; ++worker) {
+            std::size_t first = worker * num_tasks / num_workers;
+            std::size_t last = (worker + 1) * num_tasks / num_workers;
+            for (std::size_t index = first; index < last; ++index) {
+                queues[worker].tasks.push_back(index);
+            }
+        }
+        auto work = [&queues, &task, num_workers] (std::size_t worker) {
+            std::size_t index;
+            while (true) {
+                if (queues[worker].popFront(index)) {
+                    task(index);
+                    continue;
+                }
+                bool stolen = false;
+                for (std::size_t step = 1; step < num_workers && !stolen; ++step) {
+                    stolen = queues[(worker + step) % num_workers].popBack(index);
+                }
+                if (!stolen)    return;
+                task(index);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t worker = 1; worker < num_workers; ++worker) {
+            threads.emplace_back(work, worker);
+        }
+        work(0);
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+} //AccountBalancer
@@ -0,0 +1,25 @@
+//Run a batch of independent tasks on several threads
+//the tasks are dealt out to the workers in contiguous blocks, every worker takes tasks
+//from the front of its own queue and steals from the back of the others once it runs dry
+#ifndef __BALANCE_WORK_STEALING_POOL_H
+#define __BALANCE_WORK_STEALING_POOL_H
+#include <cstddef>
+#include <functional>
+
+namespace AccountBalancer {
+    class WorkStealingPool {
+    public:
+        //0 means one thread per hardware thread
+        explicit WorkStealingPool(unsigned threads = 0);
+
+        unsigned numOfThreads() const noexcept;
+
+        //call task(index) for every index in [0, num_tasks), return once all of them are done
+        //the calling thread works as one of the workers, task must be safe to call concurrently
+        void run(std::size_t num_tasks, const std::function<void(std::size_t)>& task) const;
+
+    private:
+        unsigned num_threads;
+    };
+} //AccountBalancer
+#endif
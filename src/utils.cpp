@@ -1,3 +1,5 @@
+#include <chrono>
+#include <cstdio>
 #include <sstream>
 
 #include "utils.h"
@@ -31,6 +33,55 @@ namespace AccountBalancer {
             return ss.str();
         }
 
+        //the civil calendar conversions follow the days_from_civil/civil_from_days
+        //algorithms, which treat March as the first month of the year
+        int daysFromCivil(int year, int month, int day) {
+            year -= month <= 2;
+            const int era = (year >= 0? year: year - 399) / 400;
+            const int year_of_era = year - era * 400;
+            const int day_of_year = (153 * (month + (month > 2? -3: 9)) + 2) / 5 + day - 1;
+            const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+            return era * 146097 + day_of_era - 719468;
+        }
+
+        int daysInMonth(int year, int month) {
+            static const int month_days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+            const bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+            return month == 2 && leap? 29: month_days[month - 1];
+        }
+
+        bool parseDate(const std::string& str, int& days) {
+            int year, month, day;
+            char trailing;
+            if (std::sscanf(str.c_str(), "%d-%d-%d%c", &year, &month, &day, &trailing) != 3)
+                return false;
+            if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month))
+                return false;
+            days = daysFromCivil(year, month, day);
+            return true;
+        }
+
+        std::string formatDate(int days) {
+            days += 719468;
+            const int era = (days >= 0? days: days - 146096) / 146097;
+            const int day_of_era = days - era * 146097;
+            const int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+                    - day_of_era / 146096) / 365;
+            const int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+            const int mp = (5 * day_of_year + 2) / 153;
+            const int day = day_of_year - (153 * mp + 2) / 5 + 1;
+            const int month = mp < 10? mp + 3: mp - 9;
+            const int year = year_of_era + era * 400 + (month <= 2);
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+            return buffer;
+        }
+
+        int today() {
+            auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+            return std::chrono::duration_cast<std::chrono::hours>(since_epoch).count() / 24;
+        }
+
     } //Utils
 } //AccountBalancer
                         
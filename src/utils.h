@@ -44,6 +44,22 @@ namespace AccountBalancer {
         //concatenate multiple string tokens into single space separated string
         std::string concatTokens(const std::vector<std::string>& tokens, int start, int end);
 
+        //dates are kept as the number of days since 1970-01-01
+        int daysFromCivil(int year, int month, int day);
+
+        //the number of days of a month (1 to 12), February has 29 in leap years
+        int daysInMonth(int year, int month);
+
+        //parse a date in YYYY-MM-DD format, return false if it is malformed or the day
+        //does not exist in that month
+        bool parseDate(const std::string& str, int& days);
+
+        //format the days back into YYYY-MM-DD
+        std::string formatDate(int days);
+
+        //the current date (UTC)
+        int today();
+
     } // Utils
 }  //AccountBalancer
 #endif
@@ -0,0 +1,68 @@
+//peak memory, build and tear-down time of a million expenses made on the heap against
+//the same expenses made in a LedgerArena, each run in a child process of its own so that
+//the peak resident set sizes do not mix
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/Expense.h"
+#include "../src/ExpenseBuilder.h"
+#include "../src/LedgerArena.h"
+
+using namespace AccountBalancer;
+namespace {
+    constexpr int num_expenses = 1000000;
+    constexpr int num_participants = 11;
+
+    double secondsSince(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void run(bool use_arena) {
+        std::vector<std::pair<std::string, int>> weights;
+        for (int pos = 0; pos < num_participants; ++pos) {
+            weights.push_back(std::make_pair("Participant_" + std::to_string(pos), pos % 3 + 1));
+        }
+        std::sort(weights.begin(), weights.end());
+
+        std::unique_ptr<LedgerArena> arena;
+        if (use_arena)  arena = std::make_unique<LedgerArena>();
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::shared_ptr<Expense>> expenses;
+            expenses.reserve(num_expenses);
+            ExpenseBuilder builder("Participant_0", 100.0);
+            builder.setNote("Team lunch at the usual place downtown");
+            builder.setWeights(weights);
+            builder.setArena(arena.get());
+            for (int pos = 0; pos < num_expenses; ++pos) {
+                expenses.push_back(builder.build());
+            }
+            double built = secondsSince(start);
+            start = std::chrono::steady_clock::now();
+            expenses.clear();
+            arena.reset();
+            double torn_down = secondsSince(start);
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            printf("%-6s build %7.3fs  tear-down %7.3fs  peak RSS %8ld KB\n",
+                    use_arena? "arena": "heap", built, torn_down, usage.ru_maxrss);
+        }
+    }
+} //anonymous namespace
+
+int main() {
+    printf("%d expenses of %d participants\n", num_expenses, num_participants);
+    for (bool use_arena: {false, true}) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            run(use_arena);
+            return 0;
+        }
+        waitpid(child, nullptr, 0);
+    }
+}
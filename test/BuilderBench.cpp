@@ -0,0 +1,56 @@
+//compare building expenses step by step (addParticipant, changeWeights) as SkiTest does
+//against the ExpenseBuilder, which takes sorted weights and records no history
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "../src/Expense.h"
+#include "../src/ExpenseBuilder.h"
+
+using namespace AccountBalancer;
+namespace {
+    constexpr int num_expenses = 200000;
+    constexpr int num_participants = 11;
+
+    double secondsSince(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+} //anonymous namespace
+
+int main() {
+    std::vector<std::string> names;
+    std::vector<std::pair<std::string, int>> weights;
+    for (int pos = 0; pos < num_participants; ++pos) {
+        names.push_back("Participant_" + std::to_string(pos));
+        weights.push_back(std::make_pair(names.back(), pos % 3 + 1));
+    }
+    //the builder takes the participants sorted by name
+    std::sort(weights.begin(), weights.end());
+
+    std::vector<std::shared_ptr<Expense>> expenses;
+    expenses.reserve(num_expenses);
+    auto start = std::chrono::steady_clock::now();
+    for (int pos = 0; pos < num_expenses; ++pos) {
+        auto expense = std::make_shared<Expense>(names[pos % num_participants], 100.0, "Groceries");
+        expense->addParticipant(names);
+        expense->changeWeights(weights);
+        expenses.push_back(std::move(expense));
+    }
+    double step_by_step = secondsSince(start);
+    expenses.clear();
+
+    start = std::chrono::steady_clock::now();
+    for (int pos = 0; pos < num_expenses; ++pos) {
+        ExpenseBuilder builder(names[pos % num_participants], 100.0);
+        builder.setNote("Groceries");
+        builder.setWeights(weights);
+        expenses.push_back(builder.build());
+    }
+    double built = secondsSince(start);
+
+    printf("%d expenses of %d participants\n", num_expenses, num_participants);
+    printf("addParticipant + changeWeights: %8.3fs %8.0fns per expense\n",
+            step_by_step, step_by_step * 1e9 / num_expenses);
+    printf("ExpenseBuilder:                 %8.3fs %8.0fns per expense\n",
+            built, built * 1e9 / num_expenses);
+}
@@ -0,0 +1,99 @@
+//commit throughput of several producer threads pushing expenses at once, the sharded
+//ExpenseQueue against a single deque behind one lock, the time draining the queue takes,
+//then a check that draining gives every expense back with each producer's expenses in the
+//order they were pushed
+//the shards only pay off when the producers really run in parallel, on a single hardware
+//thread they take turns and the extra sequence number makes the queue slower than one lock
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "../src/Expense.h"
+#include "../src/ExpenseBuilder.h"
+#include "../src/ExpenseQueue.h"
+
+using namespace AccountBalancer;
+namespace {
+    constexpr int num_expenses = 1 << 20;
+    constexpr int max_producers = 8;
+
+    double secondsSince(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    //run producers threads, each calling push on its own slice of the expenses
+    template <typename Push>
+    double produce(int producers, const std::vector<std::shared_ptr<Expense>>& expenses,
+            Push push) {
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int producer = 0; producer < producers; ++producer) {
+            threads.emplace_back([producer, producers, &expenses, &push] () {
+                for (std::size_t pos = producer; pos < expenses.size(); pos += producers) {
+                    push(expenses[pos]);
+                }
+            });
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        return secondsSince(start);
+    }
+} //anonymous namespace
+
+int main() {
+    //the expenses are built up front, only the commits are timed
+    std::vector<std::shared_ptr<Expense>> expenses;
+    expenses.reserve(num_expenses);
+    for (int pos = 0; pos < num_expenses; ++pos) {
+        ExpenseBuilder builder("Card_" + std::to_string(pos % 64), 12.5);
+        builder.setWeights({{"Alice", 1}, {"Bob", 2}});
+        expenses.push_back(builder.build());
+    }
+    std::unordered_map<const Expense*, int> position;
+    for (int pos = 0; pos < num_expenses; ++pos) {
+        position[expenses[pos].get()] = pos;
+    }
+
+    const unsigned cores = std::thread::hardware_concurrency();
+    printf("%d expenses, %u hardware threads\n", num_expenses, cores);
+    if (cores <= 1) {
+        printf("the producers can not run in parallel here, no scaling can show\n");
+    }
+    printf("%10s %20s %20s %12s\n", "producers", "single lock (M/s)", "ExpenseQueue (M/s)",
+            "drain (ms)");
+    bool ordered = true;
+    for (int producers = 1; producers <= max_producers; producers *= 2) {
+        std::deque<std::shared_ptr<Expense>> deque;
+        std::mutex lock;
+        double locked = produce(producers, expenses, [&deque, &lock] (const std::shared_ptr<Expense>& expense) {
+            std::lock_guard<std::mutex> guard(lock);
+            deque.push_front(expense);
+        });
+
+        ExpenseQueue queue;
+        double sharded = produce(producers, expenses, [&queue] (const std::shared_ptr<Expense>& expense) {
+            queue.push(expense);
+        });
+        std::vector<std::shared_ptr<Expense>> drained;
+        auto start = std::chrono::steady_clock::now();
+        queue.drain(drained);
+        double draining = secondsSince(start);
+
+        //producer p pushed the positions p, p + producers, ... in increasing order
+        std::vector<int> last(producers, -1);
+        ordered = ordered && drained.size() == expenses.size();
+        for (auto& expense: drained) {
+            int pos = position[expense.get()];
+            ordered = ordered && pos > last[pos % producers];
+            last[pos % producers] = pos;
+        }
+        printf("%10d %20.2f %20.2f %12.1f\n", producers, num_expenses / locked / 1e6,
+                num_expenses / sharded / 1e6, draining * 1e3);
+    }
+    printf("drained in push order: %s\n", ordered? "yes": "NO");
+    return ordered? 0: 1;
+}
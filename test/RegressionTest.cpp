@@ -0,0 +1,819 @@
+//checks of corner cases found in review, every failed check is reported
+//the exit code is the number of failed checks
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/utils.h"
+#include "../src/ExactSolver.h"
+#include "../src/WorkStealingPool.h"
+#include "../src/LocalSearch.h"
+#include "../src/Expense.h"
+#include "../src/Optimizer.h"
+#include "../src/ParticipantIndex.h"
+#include "../src/ResultCache.h"
+#include "../src/Control.h"
+#include "../src/NameTable.h"
+#include "../src/ExpenseBuilder.h"
+#include "../src/LedgerArena.h"
+#include "../src/BalanceIndex.h"
+
+using namespace AccountBalancer;
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const std::string& what) {
+        if (!condition) {
+            std::cerr << "FAILED: " << what << std::endl;
+            ++failures;
+        }
+    }
+
+    //days that do not exist in their month are rejected, leap years included
+    void testParseDate() {
+        int days = 0;
+        check(Utils::parseDate("2024-02-29", days), "2024-02-29 is a leap day");
+        check(Utils::formatDate(days) == "2024-02-29", "2024-02-29 formats back");
+        check(Utils::parseDate("2000-02-29", days), "2000-02-29 is a leap day");
+        check(Utils::parseDate("2023-12-31", days), "2023-12-31 exists");
+        check(!Utils::parseDate("2023-02-29", days), "2023-02-29 is rejected");
+        check(!Utils::parseDate("1900-02-29", days), "1900-02-29 is rejected");
+        check(!Utils::parseDate("2024-02-30", days), "2024-02-30 is rejected");
+        check(!Utils::parseDate("2024-02-31", days), "2024-02-31 is rejected");
+        check(!Utils::parseDate("2023-04-31", days), "2023-04-31 is rejected");
+        check(!Utils::parseDate("2023-11-31", days), "2023-11-31 is rejected");
+        check(!Utils::parseDate("2023-01-00", days), "2023-01-00 is rejected");
+        check(!Utils::parseDate("2023-13-01", days), "2023-13-01 is rejected");
+    }
+
+    //a search stopped by its node budget returns the same plan on any number of threads
+    void testExactSolverThreads() {
+        std::mt19937 rng(1);
+        std::vector<long long> cents(40);
+        long long sum = 0;
+        for (std::size_t pos = 0; pos + 1 < cents.size(); ++pos) {
+            cents[pos] = (static_cast<long long>(rng() % 60) - 30) * 125;
+            if (!cents[pos])    cents[pos] = 375;
+            sum += cents[pos];
+        }
+        cents.back() = -sum;
+        std::vector<Settlement> reference;
+        for (unsigned threads: {1u, 2u, 4u, 8u}) {
+            WorkStealingPool pool(threads);
+            ExactSolver<64> solver(cents.data(), cents.size());
+            bool proven = solver.solve(1 << 16, pool);
+            std::vector<Settlement> plan(solver.begin(), solver.end());
+            check(!proven, "the exact search runs out of nodes on 40 gaps");
+            if (threads == 1) {
+                reference = plan;
+                continue;
+            }
+            bool same = plan.size() == reference.size();
+            for (std::size_t pos = 0; same && pos < plan.size(); ++pos) {
+                same = plan[pos].from == reference[pos].from && plan[pos].to == reference[pos].to
+                    && plan[pos].cents == reference[pos].cents;
+            }
+            check(same, "the exact search plan on " + std::to_string(threads)
+                    + " threads is the one found on a single thread");
+        }
+    }
+
+    //four zero-sum groups of six without any zero-sum pair, triple or quadruple, the first
+    //split finds no group at all and the search has to carve the whole ledger
+    void testLocalSearchSingleGroup() {
+        const std::vector<long long> cents = {-541, -8620, -4533, 8601, -8837, 13930,
+            7622, 2265, -7204, -5868, -2168, 5353, 5608, -7968, -6262, -8561, -3720, 20903,
+            5015, -1540, 1823, 3343, 6310, -14951};
+        LocalSearch search(cents);
+        search.run(std::chrono::milliseconds(200));
+        check(search.numOfTransfers() <= 20, "the local search finds the four hidden groups, "
+                + std::to_string(search.numOfTransfers()) + " transfers");
+        std::size_t members = 0;
+        for (auto& group: search.getGroups()) {
+            long long sum = 0;
+            for (int pos: group)    sum += cents[pos];
+            check(sum == 0, "every local search group sums up to zero");
+            members += group.size();
+        }
+        check(members == cents.size(), "the local search groups cover every gap");
+    }
+
+    //a hypothetical expense nobody shares is rejected instead of spreading inf and NaN
+    void testSimulateZeroWeight() {
+        auto dinner = std::make_shared<Expense>("Ann", 30.0, "Dinner");
+        dinner->addParticipant({"Ann", "Bob", "Cid"});
+        BalanceOptimizer optimizer;
+        optimizer.optimizeExpenses({dinner}, OptimizerStrategy::LAZY);
+
+        auto unshared = std::make_shared<Expense>("Bob", 12.0, "Taxi");
+        unshared->addParticipant({"Bob", "Cid"});
+        unshared->changeWeights({{"Bob", 0}, {"Cid", 0}});
+        std::vector<Utils::Debt> transfers;
+        check(optimizer.simulateExpenses({unshared}, OptimizerStrategy::LAZY, transfers)
+                == OptimizerStatus::FAILED, "simulating an expense of zero total weight fails");
+        auto nobody = std::make_shared<Expense>("Bob", 12.0, "Taxi");
+        check(optimizer.simulateExpenses({nobody}, OptimizerStrategy::LAZY, transfers)
+                == OptimizerStatus::FAILED, "simulating an expense without participants fails");
+
+        auto shared = std::make_shared<Expense>("Bob", 12.0, "Taxi");
+        shared->addParticipant({"Bob", "Cid"});
+        check(optimizer.simulateExpenses({shared}, OptimizerStrategy::LAZY, transfers)
+                == OptimizerStatus::SUCCESS, "simulating a shared expense succeeds");
+        for (auto& transfer: transfers) {
+            check(std::isfinite(transfer.amount), "simulated transfers are finite");
+        }
+    }
+
+    //the summary of someone who only has a balance carried forward from a settled epoch,
+    //the optimizer is set up the way Control leaves it after settle: a fresh index and
+    //the closing balances as opening balances
+    void testSummaryAfterSettle() {
+        auto index = std::make_shared<ParticipantIndex>();
+        auto lunch = std::make_shared<Expense>("Ann", 30.0, "Lunch");
+        lunch->addParticipant({"Ann", "Bob", "Cid"});
+        index->addExpense(lunch);
+        BalanceOptimizer optimizer;
+        optimizer.setParticipantIndex(index);
+        optimizer.setOpeningBalances({{"Ann", 5.0}, {"Bob", -12.5}, {"Dan", 7.5}});
+        optimizer.optimizeExpenses({lunch}, OptimizerStrategy::LAZY);
+
+        std::ostringstream captured;
+        auto* saved = std::cout.rdbuf(captured.rdbuf());
+        OptimizerStatus dan = optimizer.printParticipantSummary("Dan");
+        std::string dan_report = captured.str();
+        captured.str("");
+        OptimizerStatus bob = optimizer.printParticipantSummary("Bob");
+        std::string bob_report = captured.str();
+        std::cout.rdbuf(saved);
+
+        check(dan == OptimizerStatus::SUCCESS, "the summary of an opening balance only succeeds");
+        check(dan_report.find("Total amount of expense:    $0.00") != std::string::npos,
+                "an opening balance only has no expense");
+        check(dan_report.find("Total payment made:         $7.50") != std::string::npos,
+                "an opening balance owed counts as a payment");
+        check(dan_report.find("Suggested Transfers") != std::string::npos,
+                "the summary of an opening balance only has its transfers");
+        check(bob == OptimizerStatus::SUCCESS, "the summary with expenses and an opening balance succeeds");
+        check(bob_report.find("Total amount of expense:    $22.50") != std::string::npos,
+                "an opening balance owing is part of the total expense");
+    }
+
+    //a chain of expenses, person j pays person j + 1 whatever is needed so that the gap
+    //of person j ends up at cents[j]
+    std::vector<std::shared_ptr<Expense>> chainLedger(const std::vector<long long>& cents) {
+        std::vector<std::shared_ptr<Expense>> expenses;
+        long long carried = 0;
+        for (std::size_t pos = 0; pos + 1 < cents.size(); ++pos) {
+            carried += cents[pos];
+            std::string name = "P" + std::to_string(pos), next = "P" + std::to_string(pos + 1);
+            if (!carried)   continue;
+            auto expense = std::make_shared<Expense>(carried > 0 ? name : next,
+                    std::abs(carried) / 100.0, "Chain");
+            expense->addParticipant({carried > 0 ? next : name});
+            expenses.push_back(expense);
+        }
+        return expenses;
+    }
+
+    //a plan is cached only when rerunning could not find a better one: an exact search
+    //that ran out of nodes is not cached and the local search key carries its time budget
+    void testCacheProvenPlans() {
+        std::mt19937 rng(1);
+        std::vector<long long> cents(40);
+        long long sum = 0;
+        for (std::size_t pos = 0; pos + 1 < cents.size(); ++pos) {
+            cents[pos] = (static_cast<long long>(rng() % 2000) - 1000) * 7 + 3;
+            sum += cents[pos];
+        }
+        cents.back() = -sum;
+        BalanceOptimizer optimizer;
+        optimizer.optimizeExpenses(chainLedger(cents), OptimizerStrategy::LEAST_TRANSFER);
+        check(optimizer.getResultCache()->size() == 0,
+                "an exact search out of nodes does not cache its plan");
+        optimizer.optimizeExpenses(chainLedger({500, -200, -300}), OptimizerStrategy::LEAST_TRANSFER);
+        check(optimizer.getResultCache()->size() == 1, "a proven least transfer plan is cached");
+
+        GapList creditors = {{"Ann", 5.0}}, debtors = {{"Bob", 5.0}};
+        using std::chrono::milliseconds;
+        check(ResultCache::makeKey(creditors, debtors, OptimizerStrategy::LOCAL_SEARCH,
+                    milliseconds(10)).canonical
+                != ResultCache::makeKey(creditors, debtors, OptimizerStrategy::LOCAL_SEARCH,
+                    milliseconds(1000)).canonical,
+                "local search runs of different time budgets do not share a cache entry");
+        check(ResultCache::makeKey(creditors, debtors, OptimizerStrategy::LAZY,
+                    milliseconds(10)).canonical
+                == ResultCache::makeKey(creditors, debtors, OptimizerStrategy::LAZY,
+                    milliseconds(1000)).canonical,
+                "the time budget is not part of the key of the other strategies");
+    }
+
+    bool hasTransfer(const std::vector<Utils::Debt>& transfers, const std::string& creditor,
+            const std::string& debtor, double amount) {
+        for (auto& transfer: transfers) {
+            if (transfer.creditor == creditor && transfer.debtor == debtor
+                    && Utils::isEqual(transfer.amount, amount)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //a warm start keeps the transfers of people an added expense does not touch, and
+    //answers from the last plan rather than from the cache, even for a cached state
+    void testWarmStartStability() {
+        auto lunch = std::make_shared<Expense>("Ann", 30.0, "Lunch");
+        lunch->addParticipant({"Ann", "Bob", "Cid"});
+        auto taxi = std::make_shared<Expense>("Dan", 40.0, "Taxi");
+        taxi->addParticipant({"Dan", "Eve"});
+        BalanceOptimizer optimizer;
+        optimizer.setWarmStart(true);
+        optimizer.optimizeExpenses({lunch, taxi}, OptimizerStrategy::LEAST_TRANSFER);
+        auto before = optimizer.getTransfers();
+        check(optimizer.getResultCache()->size() == 1, "the first run of a warm start is cached");
+
+        //only Cid and Fay have a new balance
+        auto coffee = std::make_shared<Expense>("Fay", 10.0, "Coffee");
+        coffee->addParticipant({"Fay", "Cid"});
+        optimizer.optimizeExpenses({lunch, taxi, coffee}, OptimizerStrategy::LEAST_TRANSFER);
+        auto after = optimizer.getTransfers();
+        for (auto& transfer: before) {
+            if (transfer.debtor == "Cid")   continue;
+            check(hasTransfer(after, transfer.creditor, transfer.debtor, transfer.amount),
+                    "a warm start keeps " + transfer.debtor + " paying " + transfer.creditor);
+        }
+        check(after.size() == before.size() + 1, "a warm start adds a single transfer for the "
+                "coffee, " + std::to_string(after.size()) + " transfers");
+        check(optimizer.getResultCache()->size() == 1, "a warm started plan is not cached");
+
+        //the cold state is in the cache, a warm start still repairs its last plan
+        std::ostringstream captured;
+        auto* saved = std::cerr.rdbuf(captured.rdbuf());
+        optimizer.setVerbose(true);
+        optimizer.optimizeExpenses({lunch, taxi}, OptimizerStrategy::LEAST_TRANSFER);
+        std::cerr.rdbuf(saved);
+        check(captured.str().find("transfers kept") != std::string::npos,
+                "a warm start does not look up the cache");
+    }
+
+    std::vector<std::string> readLines(const std::string& path) {
+        std::ifstream in(path);
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    //"opt -o" streams the transfers to a file, csv unless the file name ends in .bin
+    void testOptOutput() {
+        Control& control = Control::getControl();
+        auto dinner = std::make_shared<Expense>("Ann", 30.0, "Dinner");
+        dinner->addParticipant({"Ann", "Bob", "Cid"});
+        control.submitExpense(dinner);
+        std::ostringstream captured;
+        auto* saved = std::cout.rdbuf(captured.rdbuf());
+        control.runCommand({"opt", "-e", "-o", "regression_transfers.csv"});
+        control.runCommand({"opt", "-e", "-o", "regression_transfers.bin"});
+        control.runCommand({"undo"});
+        std::cout.rdbuf(saved);
+
+        check(readLines("regression_transfers.csv")
+                == std::vector<std::string>{"payer,payee,amount", "Bob,Ann,10.00", "Cid,Ann,10.00"},
+                "opt -o writes the transfers as csv");
+        std::ifstream binary("regression_transfers.bin", std::ios::binary);
+        char magic[4] = {};
+        binary.read(magic, sizeof(magic));
+        check(std::string(magic, sizeof(magic)) == "ABT1",
+                "opt -o writes the binary format to a .bin file");
+        check(captured.str().find("wrote 2 transfers") != std::string::npos,
+                "opt -o reports the transfers written");
+        std::remove("regression_transfers.csv");
+        std::remove("regression_transfers.bin");
+    }
+
+    //groups of less than four members cannot get any better, the search stops right away
+    //instead of spinning through its time budget
+    void testLocalSearchSmallGroups() {
+        using std::chrono::steady_clock;
+        //[balances, least transfers]
+        const std::vector<std::pair<std::vector<long long>, int>> ledgers = {
+            {{100, 200, -300}, 2},
+            {{100, 250, -350, 700, -400, -300, 40, -40}, 5}};
+        for (auto& ledger: ledgers) {
+            LocalSearch search(ledger.first);
+            auto start = steady_clock::now();
+            search.run(std::chrono::milliseconds(5000));
+            check(steady_clock::now() - start < std::chrono::seconds(1),
+                    "the local search stops once no group has four members");
+            check(search.numOfTransfers() == ledger.second,
+                    "the local search keeps its groups of less than four members");
+        }
+
+        //the strategy is reachable from the main menu
+        Control& control = Control::getControl();
+        auto dinner = std::make_shared<Expense>("Ann", 30.0, "Dinner");
+        dinner->addParticipant({"Ann", "Bob", "Cid"});
+        control.submitExpense(dinner);
+        std::ostringstream captured;
+        auto* saved = std::cout.rdbuf(captured.rdbuf());
+        control.runCommand({"opt", "-s", "-o", "regression_search.csv"});
+        control.runCommand({"undo"});
+        std::cout.rdbuf(saved);
+        check(readLines("regression_search.csv").size() == 3, "opt -s writes two transfers");
+        std::remove("regression_search.csv");
+    }
+
+    //settle only takes the transfers of an "opt" newer than the last commit as executed
+    void testSettleAfterCommit() {
+        Control& control = Control::getControl();
+        auto dinner = std::make_shared<Expense>("Ann", 30.0, "Dinner");
+        dinner->addParticipant({"Ann", "Bob", "Cid"});
+        control.submitExpense(dinner);
+        std::ostringstream captured;
+        auto* saved = std::cout.rdbuf(captured.rdbuf());
+        control.runCommand({"opt", "-e"});
+        auto taxi = std::make_shared<Expense>("Bob", 12.0, "Taxi");
+        taxi->addParticipant({"Bob", "Cid"});
+        control.submitExpense(taxi);
+        control.runCommand({"settle", "regression_archive.txt"});
+        std::string stale = captured.str();
+        captured.str("");
+        control.runCommand({"opt", "-e"});
+        control.runCommand({"settle", "regression_archive.txt"});
+        std::string fresh = captured.str();
+        std::cout.rdbuf(saved);
+
+        check(stale.find("archived 2 expenses and 0 transfers") != std::string::npos,
+                "settle ignores the transfers of an opt older than the last commit");
+        check(stale.find("3 balances carried forward") != std::string::npos,
+                "settle carries every balance forward without a valid opt");
+        check(fresh.find("archived 0 expenses and 2 transfers") != std::string::npos,
+                "settle takes the transfers of an up to date opt as executed");
+        check(fresh.find("0 balances carried forward") != std::string::npos,
+                "the executed transfers settle every balance");
+        std::remove("regression_archive.txt");
+    }
+
+    //a ledger in several currencies is committed and optimized in the base currency
+    void testMixedCurrencyLedger() {
+        Control& control = Control::getControl();
+        ExchangeRates rates("USD");
+        rates.setRate("EUR", 1.1);
+        check(control.setExchangeRates(rates), "exchange rates can be set on the ledger");
+        auto dinner = std::make_shared<Expense>("Ann", 30.0, "Dinner");
+        dinner->addParticipant({"Ann", "Bob", "Cid"});
+        auto taxi = std::make_shared<Expense>("Bob", 20.0, "Taxi");
+        taxi->setCurrency("EUR");
+        taxi->addParticipant({"Bob", "Cid"});
+        auto sushi = std::make_shared<Expense>("Cid", 5000.0, "Sushi");
+        sushi->setCurrency("JPY");
+        sushi->addParticipant({"Ann", "Cid"});
+        control.submitExpense(dinner);
+        control.submitExpense(taxi);
+        std::ostringstream captured, errors;
+        auto* saved = std::cout.rdbuf(captured.rdbuf());
+        auto* saved_errors = std::cerr.rdbuf(errors.rdbuf());
+        control.submitExpense(sushi);
+        control.runCommand({"opt", "-e", "-o", "regression_currency.csv"});
+        ExchangeRates without_euro("USD");
+        check(!control.setExchangeRates(without_euro),
+                "rates missing a currency of the ledger are rejected");
+        control.runCommand({"undo"});
+        control.runCommand({"undo"});
+        std::cout.rdbuf(saved);
+        std::cerr.rdbuf(saved_errors);
+
+        check(errors.str().find("expense Sushi is not committed") != std::string::npos,
+                "an expense in a currency without a rate is not committed");
+        check(readLines("regression_currency.csv")
+                == std::vector<std::string>{"payer,payee,amount", "Cid,Bob,1.00", "Cid,Ann,20.00"},
+                "the transfers of a mixed currency ledger are in the base currency");
+        std::remove("regression_currency.csv");
+        check(control.setExchangeRates(ExchangeRates("USD")), "the default rates are restored");
+    }
+
+    //an indexed expense only keeps the IDs of its own participants, however many names
+    //the index has interned, and stays in step with its weights
+    void testInternedWeights() {
+        ParticipantIndex index;
+        for (int pos = 0; pos < 1000; ++pos) {
+            auto filler = std::make_shared<Expense>("P" + std::to_string(pos), 1.0, "Filler");
+            filler->addParticipant({"P" + std::to_string(pos)});
+            index.addExpense(filler);
+        }
+        auto lunch = std::make_shared<Expense>("Ann", 30.0, "Lunch");
+        lunch->addParticipant({"Ann", "Bob"});
+        index.addExpense(lunch);
+        check(lunch->getInternedWeights().size() == 2,
+                "an expense of two keeps two interned weights");
+        lunch->addParticipant({"P7"});
+        lunch->changeWeights({{"Bob", 3}});
+        lunch->removeParticipant({"Ann"});
+        auto& interned = lunch->getInternedWeights();
+        check(interned.size() == 2 && interned[0].first < interned[1].first,
+                "the interned weights follow the participants sorted by ID");
+        check(lunch->hasParticipant(index.getNameTable()->find("P7"))
+                && !lunch->hasParticipant(index.getNameTable()->find("Ann")),
+                "membership by ID follows the changes");
+        check(index.sharedExpenses("Bob", "P7").size() == 1
+                && index.sharedExpenses("Ann", "Bob").empty(),
+                "shared expenses are found by the interned IDs");
+    }
+
+    //an expense made in an arena gives every byte back when it is destroyed, which is what
+    //release checks in debug builds
+    void testArenaBytesInUse() {
+        LedgerArena arena;
+        {
+            ExpenseBuilder builder("Ann", 30.0);
+            builder.setNote("A note too long for the small string buffer of the note");
+            builder.setWeights({{"Ann", 1}, {"Bob", 2}, {"Cid", 1}});
+            builder.setArena(&arena);
+            auto lunch = builder.build();
+            auto copy = lunch;
+            lunch->changeWeights({{"Dan", 1}});
+            check(arena.bytesInUse() > 0, "an expense in the arena holds bytes of it");
+        }
+        check(arena.bytesInUse() == 0, "a destroyed expense gives every byte of the arena back");
+        check(arena.bytesAllocated() > 0, "the bytes handed out stay counted until release");
+        arena.release();
+        check(arena.bytesAllocated() == 0 && arena.bytesReserved() == 0,
+                "release frees every block");
+    }
+
+    //the least transfers of a small ledger by going through every subset: a ledger split
+    //into g zero-sum groups settles with n - g transfers, best[mask] is the most groups
+    //that the gaps of mask can be ordered into, one more whenever a prefix sums up to zero
+    int exhaustiveTransfers(const std::vector<long long>& cents) {
+        const std::size_t n = cents.size(), full = (1u << n) - 1;
+        std::vector<int> best(full + 1, 0);
+        std::vector<long long> sum(full + 1, 0);
+        for (std::size_t mask = 1; mask <= full; ++mask) {
+            for (std::size_t pos = 0; pos < n; ++pos) {
+                if (!(mask >> pos & 1)) continue;
+                sum[mask] = sum[mask ^ (1u << pos)] + cents[pos];
+                best[mask] = std::max(best[mask], best[mask ^ (1u << pos)]);
+            }
+            if (!sum[mask]) ++best[mask];
+        }
+        return static_cast<int>(n) - best[full];
+    }
+
+    //small random ledgers, the gaps drawn from a few amounts so that zero-sum groups are
+    //common, the exact solver (subset dynamic programming up to 16 gaps, branch and bound
+    //above) needs as few transfers as going through every subset and its plan settles
+    //every gap
+    void testExactSolverExhaustive() {
+        std::mt19937 rng(7);
+        WorkStealingPool pool(1);
+        for (int round = 0; round < 200; ++round) {
+            std::vector<long long> cents(3 + rng() % 6);
+            long long sum = 0;
+            for (std::size_t pos = 0; pos + 1 < cents.size(); ++pos) {
+                cents[pos] = (static_cast<long long>(rng() % 9) - 4) * 250;
+                if (!cents[pos])    cents[pos] = 750;
+                sum += cents[pos];
+            }
+            cents.back() = -sum;
+            if (!sum)   cents.pop_back();
+            const int expected = exhaustiveTransfers(cents);
+            ExactSolver<8> narrow(cents.data(), cents.size());
+            ExactSolver<32> wide(cents.data(), cents.size());
+            check(narrow.solve(1 << 20, pool) && wide.solve(1 << 20, pool),
+                    "the exact search proves a small ledger");
+            std::vector<Settlement> plan(narrow.begin(), narrow.end());
+            check(static_cast<int>(plan.size()) == expected, "the exact search needs "
+                    + std::to_string(plan.size()) + " transfers where going through every subset needs "
+                    + std::to_string(expected));
+            check(static_cast<int>(std::distance(wide.begin(), wide.end())) == expected,
+                    "the branch and bound needs as few transfers as the subset dynamic programming");
+            std::vector<long long> left = cents;
+            for (auto& settlement: plan) {
+                left[settlement.to] -= settlement.cents;
+                left[settlement.from] += settlement.cents;
+            }
+            check(std::all_of(left.begin(), left.end(), [] (long long gap) { return gap == 0; }),
+                    "the exact search plan settles every gap");
+        }
+    }
+
+    //the branch and bound spread over a pool proves the least transfers of the exhaustive
+    //search on every number of threads
+    void testExactSolverPoolExhaustive() {
+        std::mt19937 rng(11);
+        for (int round = 0; round < 50; ++round) {
+            std::vector<long long> cents(6 + rng() % 7);
+            long long sum = 0;
+            for (std::size_t pos = 0; pos + 1 < cents.size(); ++pos) {
+                cents[pos] = (static_cast<long long>(rng() % 13) - 6) * 125;
+                if (!cents[pos])    cents[pos] = 875;
+                sum += cents[pos];
+            }
+            cents.back() = -sum;
+            if (!sum)   cents.pop_back();
+            const int expected = exhaustiveTransfers(cents);
+            for (unsigned threads: {1u, 4u}) {
+                WorkStealingPool pool(threads);
+                ExactSolver<64> solver(cents.data(), cents.size());
+                check(solver.solve(1 << 20, pool), "the pooled search proves a small ledger");
+                check(solver.numOfTransfers() == expected, "the pooled search on "
+                        + std::to_string(threads) + " threads needs "
+                        + std::to_string(solver.numOfTransfers()) + " transfers where going "
+                        "through every subset needs " + std::to_string(expected));
+            }
+        }
+    }
+
+    //one expense per debtor of every group, paid by the creditor of the group
+    std::vector<std::shared_ptr<Expense>> groupLedger(
+            const std::vector<std::vector<long long>>& groups, long long scale) {
+        std::vector<std::shared_ptr<Expense>> expenses;
+        int id = 0;
+        for (auto& group: groups) {
+            std::string creditor = "C" + std::to_string(id++);
+            for (long long cents: group) {
+                auto expense = std::make_shared<Expense>(creditor, cents * scale / 100.0, "Group");
+                expense->addParticipant({"D" + std::to_string(id++)});
+                expenses.push_back(expense);
+            }
+        }
+        return expenses;
+    }
+
+    //more than 64 gaps go through the subset matching, small amounts through the subset
+    //sum dynamic programming and large ones through the budgeted search, twenty groups
+    //of three settle in the two-sum pre-pass and two groups of four are left to the
+    //matcher, their debtors are distinct powers of two so that each creditor has a single
+    //subset, the same ledger scaled up needs the same transfers either way
+    void testSubsetMatchers() {
+        for (unsigned seed = 1; seed <= 10; ++seed) {
+            std::mt19937 rng(seed);
+            std::vector<std::vector<long long>> groups;
+            for (int group = 0; group < 20; ++group) {
+                groups.push_back({10000 + rng() % 90000, 10000 + rng() % 90000});
+            }
+            std::vector<long long> powers;
+            for (int bit = 0; bit < 10; ++bit) {
+                powers.push_back(1LL << bit);
+            }
+            std::shuffle(powers.begin(), powers.end(), rng);
+            groups.push_back({powers[0], powers[1], powers[2]});
+            groups.push_back({powers[3], powers[4], powers[5]});
+
+            std::vector<std::size_t> transfers;
+            for (long long scale: {1LL, 1000000LL}) {
+                BalanceOptimizer optimizer;
+                optimizer.optimizeExpenses(groupLedger(groups, scale),
+                        OptimizerStrategy::LEAST_TRANSFER);
+                transfers.push_back(optimizer.getTransfers().size());
+            }
+            check(transfers[0] == 46, "the subset sum dynamic programming finds every group, "
+                    + std::to_string(transfers[0]) + " transfers");
+            check(transfers[1] == transfers[0], "the budgeted search needs as many transfers as "
+                    "the dynamic programming, " + std::to_string(transfers[1]) + " transfers");
+        }
+    }
+
+    //five creditors owed by a single debtor settle as exact pairs, the 66 gaps left are
+    //too many for the exact solver, and every creditor of the 22 groups of three is owed
+    //by a pair of debtors nobody else sums to, the two-sum pre-pass settles them all
+    void testPrePassCounts() {
+        std::vector<std::vector<long long>> groups;
+        for (long long pair = 0; pair < 5; ++pair) {
+            groups.push_back({1000 + 37 * pair});
+        }
+        for (long long group = 0; group < 22; ++group) {
+            groups.push_back({10000 + 100 * group, 15000 + 7 * group});
+        }
+        BalanceOptimizer optimizer;
+        optimizer.setVerbose(true);
+        std::ostringstream captured;
+        auto* saved = std::cerr.rdbuf(captured.rdbuf());
+        optimizer.optimizeExpenses(groupLedger(groups, 1), OptimizerStrategy::LEAST_TRANSFER);
+        std::cerr.rdbuf(saved);
+        check(captured.str().find("5 exact pairs settled, 66 gaps left to search")
+                != std::string::npos, "the pair pre-pass settles the five pairs");
+        check(captured.str().find("22 gaps settled by two transfers") != std::string::npos,
+                "the two-sum pre-pass settles the 22 groups of three");
+        check(optimizer.getTransfers().size() == 49, "pairs and groups of three take 49 "
+                "transfers, " + std::to_string(optimizer.getTransfers().size()) + " transfers");
+    }
+
+    std::string weightsOf(const Expense& expense) {
+        std::string weights;
+        for (auto& weight: expense.getWeightsMap()) {
+            weights += weight.first + ":" + std::to_string(weight.second) + " ";
+        }
+        return weights;
+    }
+
+    //compacting merges the two weight changes of Bob into one commit, the depth then folds
+    //the first commit into the checkpoint, rolling back walks the commits left and stops
+    //at the checkpoint rather than at the weights the expense was created with
+    void testRollBackCompactedHistory() {
+        Expense expense("Ann", 60.0, "Dinner");
+        expense.addParticipant({"Ann", "Bob"});
+        expense.addParticipant({"Cid"});
+        expense.changeWeights({{"Bob", 2}});
+        expense.changeWeights({{"Bob", 3}});
+        check(expense.compactHistory() > 0, "compacting squashes the weight changes of Bob");
+        expense.setHistoryPolicy(2, false);
+        check(weightsOf(expense) == "Ann:1 Bob:3 Cid:1 ", "compacting keeps the weights");
+
+        expense.rollBack();
+        check(weightsOf(expense) == "Ann:1 Bob:1 Cid:1 ", "a single roll back undoes both "
+                "squashed weight changes, " + weightsOf(expense));
+        expense.rollBack();
+        check(weightsOf(expense) == "Ann:1 Bob:1 " && expense.getWeightSum() == 2,
+                "rolling back removes Cid again, " + weightsOf(expense));
+
+        std::ostringstream captured;
+        auto* saved = std::cout.rdbuf(captured.rdbuf());
+        expense.rollBack();
+        std::cout.rdbuf(saved);
+        check(captured.str().find("already in the initial commit") != std::string::npos,
+                "the checkpoint can not be rolled back");
+        check(weightsOf(expense) == "Ann:1 Bob:1 " && expense.getWeightSum() == 2,
+                "rolling back past the checkpoint keeps the weights, " + weightsOf(expense));
+    }
+
+    //the bounded heap of topCreditors and topDebtors agrees with sorting every balance,
+    //whole amounts in a small range give plenty of ties, broken by name
+    void testTopBalancesOrder() {
+        std::mt19937 rng(13);
+        for (int round = 0; round < 20; ++round) {
+            BalanceIndex index;
+            for (int entry = 0; entry < 300; ++entry) {
+                index.addBalance("P" + std::to_string(rng() % 60), static_cast<int>(rng() % 30),
+                        static_cast<double>(static_cast<int>(rng() % 21) - 10));
+            }
+            for (double sign: {1.0, -1.0}) {
+                auto sorted = index.currentBalances();
+                sorted.erase(std::remove_if(sorted.begin(), sorted.end(),
+                            [sign] (const std::pair<std::string, double>& balance) {
+                                return sign * balance.second < 0.005;
+                            }), sorted.end());
+                std::sort(sorted.begin(), sorted.end(),
+                        [sign] (const std::pair<std::string, double>& lhs,
+                            const std::pair<std::string, double>& rhs) {
+                            if (lhs.second != rhs.second)
+                                return sign * lhs.second > sign * rhs.second;
+                            return lhs.first < rhs.first;
+                        });
+                for (std::size_t k: {1, 5, 20, 100}) {
+                    auto top = sign > 0? index.topCreditors(k): index.topDebtors(k);
+                    std::vector<std::pair<std::string, double>> expected(sorted.begin(),
+                            sorted.begin() + std::min(k, sorted.size()));
+                    check(top == expected, std::string(sign > 0? "creditors": "debtors")
+                            + " top " + std::to_string(k) + " follow the full sort");
+                }
+            }
+        }
+    }
+
+    //expenses split the same way are divided once per split, the balances have to be the
+    //same as dividing every expense on its own, amounts are whole multiples of the weight
+    //sums so that every share is exact and no cent is rounded away
+    void testCoalescedSplits() {
+        std::vector<std::vector<std::pair<std::string, int>>> splits = {
+            {{"Ann", 1}, {"Bob", 1}},
+            {{"Cid", 2}, {"Bob", 1}, {"Ann", 1}},
+            {{"Eve", 4}, {"Dan", 1}, {"Cid", 3}},
+            {{"Dan", 1}, {"Bob", 1}}
+        };
+        std::vector<std::string> creditors = {"Ann", "Bob", "Cid", "Dan", "Eve", "Fay"};
+        std::mt19937 rng(17);
+        std::vector<std::shared_ptr<Expense>> expenses;
+        std::map<std::string, double> balances;
+        for (int pos = 0; pos < 200; ++pos) {
+            auto& split = splits[rng() % splits.size()];
+            //the same split is reached through different orders and weight changes
+            std::vector<std::string> names;
+            for (auto& weight: split) {
+                names.push_back(weight.first);
+            }
+            if (rng() % 2) std::reverse(names.begin(), names.end());
+            int weight_sum = 0;
+            for (auto& weight: split) {
+                weight_sum += weight.second;
+            }
+            double amount = weight_sum * static_cast<double>(1 + rng() % 50);
+            auto expense = std::make_shared<Expense>(creditors[rng() % creditors.size()],
+                    amount, "Split");
+            expense->addParticipant(names);
+            expense->changeWeights(split);
+            expenses.push_back(expense);
+
+            balances[expense->getCreditor()] += amount;
+            for (auto& weight: split) {
+                balances[weight.first] -= amount * weight.second / weight_sum;
+            }
+        }
+        BalanceOptimizer optimizer;
+        optimizer.setVerbose(true);
+        std::ostringstream captured;
+        auto* saved = std::cerr.rdbuf(captured.rdbuf());
+        optimizer.optimizeExpenses(expenses, OptimizerStrategy::LAZY);
+        std::cerr.rdbuf(saved);
+        check(captured.str().find("200 expenses in 4 distinct splits") != std::string::npos,
+                "expenses split the same way are coalesced");
+
+        std::map<std::string, double> settled;
+        for (auto& transfer: optimizer.getTransfers()) {
+            settled[transfer.creditor] += transfer.amount;
+            settled[transfer.debtor] -= transfer.amount;
+        }
+        for (auto& balance: balances) {
+            check(std::fabs(settled[balance.first] - balance.second) < 1e-6, balance.first
+                    + " settles the balance of dividing every expense on its own");
+        }
+    }
+
+    //the report of everybody is formatted in blocks by the worker threads, with and without
+    //the participant index, and has to read the same as printing every summary in turn
+    void testAllSummariesOrder() {
+        std::mt19937 rng(19);
+        std::vector<std::shared_ptr<Expense>> expenses;
+        auto index = std::make_shared<ParticipantIndex>();
+        for (int pos = 0; pos < 400; ++pos) {
+            auto expense = std::make_shared<Expense>("P" + std::to_string(rng() % 200),
+                    (1 + rng() % 10000) / 100.0, "Item " + std::to_string(pos));
+            std::vector<std::string> names;
+            for (int member = 0; member < 2 + static_cast<int>(rng() % 4); ++member) {
+                names.push_back("P" + std::to_string(rng() % 200));
+            }
+            expense->addParticipant(names);
+            if (pos % 5 == 0)   expense->setCurrency("EUR");
+            expenses.push_back(expense);
+            index->addExpense(expense);
+        }
+        ExchangeRates rates("USD");
+        rates.setRate("EUR", 1.1);
+        for (bool use_index: {false, true}) {
+            BalanceOptimizer optimizer;
+            optimizer.setExchangeRates(rates);
+            optimizer.setNumOfThreads(4);
+            if (use_index)  optimizer.setParticipantIndex(index);
+            optimizer.optimizeExpenses(expenses, OptimizerStrategy::LEAST_TRANSFER);
+
+            std::vector<std::string> names;
+            for (auto& expense: expenses) {
+                names.push_back(expense->getCreditor());
+                for (auto& weight: expense->getWeightsMap()) {
+                    names.push_back(weight.first);
+                }
+            }
+            std::sort(names.begin(), names.end());
+            names.erase(std::unique(names.begin(), names.end()), names.end());
+
+            std::ostringstream sequential, parallel;
+            auto* saved = std::cout.rdbuf(sequential.rdbuf());
+            for (auto& name: names) {
+                optimizer.printParticipantSummary(name);
+            }
+            std::cout.rdbuf(parallel.rdbuf());
+            OptimizerStatus status = optimizer.printAllSummaries();
+            std::cout.rdbuf(saved);
+            check(status == OptimizerStatus::SUCCESS, "every summary is printed");
+            check(names.size() > 64 && !parallel.str().empty()
+                    && parallel.str() == sequential.str(), std::string("the report of everybody ")
+                    + (use_index? "with": "without") + " an index reads as the summaries in turn");
+        }
+    }
+} //anonymous namespace
+
+int main() {
+    testParseDate();
+    testExactSolverThreads();
+    testLocalSearchSingleGroup();
+    testSimulateZeroWeight();
+    testSummaryAfterSettle();
+    testCacheProvenPlans();
+    testWarmStartStability();
+    testOptOutput();
+    testLocalSearchSmallGroups();
+    testSettleAfterCommit();
+    testMixedCurrencyLedger();
+    testInternedWeights();
+    testArenaBytesInUse();
+    testExactSolverExhaustive();
+    testExactSolverPoolExhaustive();
+    testSubsetMatchers();
+    testPrePassCounts();
+    testRollBackCompactedHistory();
+    testTopBalancesOrder();
+    testCoalescedSplits();
+    testAllSummariesOrder();
+    if (!failures)  std::cout << "All checks passed" << std::endl;
+    return failures;
+}